@@ -24,6 +24,9 @@ lib.update_vcard_name.restype = ctypes.c_int  # Returns an error code
 lib.get_vcard_details.argtypes = [ctypes.c_char_p]
 lib.get_vcard_details.restype = ctypes.c_char_p  # Returns a string
 
+lib.get_valid_vcards.argtypes = [ctypes.c_char_p]
+lib.get_valid_vcards.restype = ctypes.c_char_p  # Returns newline-separated file names
+
 def show_error(screen, message, buttons=None, on_close=None, theme='warning'):
     # if buttons is None:
     #     buttons = ["OK"]
@@ -198,11 +201,12 @@ class MainView(Frame):
         self.add_layout(layout)
 
         valid_vcards = []
-        
-        for filename in os.listdir(vcard_dir):
-            if filename.endswith(".vcf"):
-                full_path = os.path.join(vcard_dir, filename).encode()
-                if lib.validate_vcard(full_path) == 0:
+
+        # Parsed and validated in parallel by the C library
+        names = lib.get_valid_vcards(vcard_dir.encode())
+        if names:
+            for filename in names.decode().splitlines():
+                if filename.endswith(".vcf"):
                     valid_vcards.append((filename, filename))
 
         self.vcard_list = ListBox(height=10, options=valid_vcards, add_scroll_bar=True, on_select=self.handle_enter)
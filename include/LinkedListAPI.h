@@ -24,6 +24,18 @@ typedef struct listNode{
     struct listNode* next;
 } Node;
 
+/**
+ * How a list stores its elements.  A linked list keeps each element in its own Node; a vector list
+ * keeps them in order in one growable array, so iterating it reads contiguous memory and
+ * getFromBack/insertBack do not touch any other element.  Both are used through the same functions,
+ * but a vector list has no Nodes: its head and tail are NULL, so only code that walks lists with
+ * an iterator may be given one.  Lists are linked unless their creator asks for a vector.
+ **/
+typedef enum listStorage { LIST_LINKED, LIST_VECTOR } ListStorage;
+
+//Number of elements a LIST_VECTOR list keeps inside its List struct before it allocates an array
+#define LIST_INLINE_ITEMS 2
+
 /**
  * Metadata head of the list. 
  * Contains no actual data but contains
@@ -34,9 +46,19 @@ typedef struct listHead{
     Node* head;
     Node* tail;
     int length;
+    //Counts every insert, delete, replace and clear, so that code keeping an index of the list can tell it changed
+    unsigned long changes;
     void (*deleteData)(void* toBeDeleted);
     int (*compare)(const void* first,const void* second);
     char* (*printData)(void* toBePrinted);
+    //If not NULL, the list head and its nodes live in this arena and are released with it
+    struct arena* arena;
+    ListStorage storage;
+    //Elements of a LIST_VECTOR list, capacity slots of which length are used.  head and tail stay NULL.
+    int capacity;
+    void** items;
+    //items points here until the list outgrows it
+    void* inlineItems[LIST_INLINE_ITEMS];
 } List;
 
 
@@ -47,6 +69,9 @@ typedef struct listHead{
  **/
 typedef struct iter{
     Node* current;
+    //Next and end element of a vector list; NULL for a linked list
+    void** item;
+    void** end;
 } ListIterator;
 
 
@@ -63,6 +88,40 @@ typedef struct iter{
 List* initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second));
 
 
+/** Function to initialize a list that uses the given storage.  initializeList always makes a LIST_LINKED list.
+* Otherwise the same as initializeList.
+*@param storage - LIST_LINKED or LIST_VECTOR
+**/
+List* initializeListWithStorage(ListStorage storage, char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second));
+
+
+
+/** Function to initialize a List struct that is part of another object, e.g. a field of a struct,
+* so that it needs no allocation of its own.  With LIST_VECTOR, a list of up to LIST_INLINE_ITEMS
+* elements allocates nothing at all.  The List must not be moved or copied while it is in use.
+*@pre list is not NULL, function pointer arguments must not be NULL
+*@post The list is empty.  Its contents must be released with clearList, never with freeList.
+*@param list - the List struct to initialize
+*@param storage - LIST_LINKED or LIST_VECTOR
+**/
+void initializeListInPlace(List* list, ListStorage storage, char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second));
+
+
+/** Function to initialize a list whose head and nodes are allocated from an arena.
+* Nothing in the list is freed individually: clearList and freeList only reset the list, and the
+* data stored in it is assumed to be owned by the same arena.  deleteFunction is never called.
+* Arena lists are always LIST_LINKED.
+*@pre arena is not NULL, function pointer arguments must not be NULL
+*@post List structure has been allocated from the arena and initialized
+*@return On success returns the new List struct. Returns NULL if the arena is out of memory
+*@param arena - the arena that owns the list
+*@param printFunction - function pointer to print a single node of the list
+*@param deleteFunction - function pointer to delete a single piece of data from the list
+*@param compareFunction - function pointer to compare two nodes of the list in order to test for equality or order
+**/
+List* initializeListInArena(struct arena* arena, char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second));
+
+
 
 /**Function for creating a node for the linked list. 
 * This node contains abstracted (void *) data as well as previous and next
@@ -72,6 +131,9 @@ List* initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFunc
 *@post data is valid to be added to a linked list
 *@return On success returns a node that can be added to a linked list. On failure, returns NULL.
 *@param data - a void * pointer to any data type.  Data must be allocated on the heap.
+* The node comes from the node pool (VCPool.h), like the nodes of linked lists that are not in an arena, so
+* clearList and freeList release it.  A node that is not linked into such a list must be freed with
+* poolFree(node, sizeof(Node)), not free.
 **/
 Node* initializeNode(void* data);
 
@@ -82,8 +144,9 @@ Node* initializeNode(void* data);
 *@pre 'List' type must exist and be used in order to keep track of the linked list.
 *@param list pointer to the List struct
 *@param toBeAdded - a pointer to data that is to be added to the linked list
+*@return false if list or toBeAdded is NULL or memory could not be allocated, in which case the list is unchanged
 **/
-void insertFront(List* list, void* toBeAdded);
+bool insertFront(List* list, void* toBeAdded);
 
 
 
@@ -92,8 +155,9 @@ void insertFront(List* list, void* toBeAdded);
 *@pre 'List' type must exist and be used in order to keep track of the linked list.
 *@param list pointer to the List struct
 *@param toBeAdded - a pointer to data that is to be added to the linked list
+*@return false if list or toBeAdded is NULL or memory could not be allocated, in which case the list is unchanged
 **/
-void insertBack(List* list, void* toBeAdded);
+bool insertBack(List* list, void* toBeAdded);
 
 
 
@@ -122,8 +186,9 @@ void clearList(List* list);
 *@post The node to be added will be placed immediately before or after the first occurrence of a related node
 *@param list - a pointer to the List struct
 *@param toBeAdded - a pointer to data that is to be added to the linked list
+*@return false if list or toBeAdded is NULL or memory could not be allocated, in which case the list is unchanged
 **/
-void insertSorted(List* list, void* toBeAdded);
+bool insertSorted(List* list, void* toBeAdded);
 
 
 
@@ -159,6 +224,16 @@ void* getFromBack(List* list);
 
 
 
+/**Replaces the data at the front of the list, without calling deleteData on the old data.
+ *@pre The list exists and has memory allocated to it
+ *@param list - a pointer to the List struct
+ *@param data - the new data, which must not be NULL
+ *@return the data that was at the front of the list, or NULL (and the list is unchanged) if it is empty
+ **/
+void* replaceFront(List* list, void* data);
+
+
+
 /**Returns a string that contains a string representation of
 the list traversed from  head to tail. Utilize the list's printData function pointer to create the string.
 returned string must be freed by the calling function.
@@ -0,0 +1,38 @@
+#ifndef _VCARENA_H
+#define _VCARENA_H
+
+#include <stddef.h>
+
+/*	Region allocator.  Allocations are bump-pointer carved out of a few large blocks and
+	can not be freed individually; destroyArena releases all of them at once.
+*/
+typedef struct arenaBlock ArenaBlock;
+
+typedef struct arena {
+	//Most recently allocated block.  Older blocks are chained behind it.
+	ArenaBlock*	blocks;
+
+	//Next free byte in the current block and how many bytes are left after it
+	char*		cursor;
+	size_t		remaining;
+
+	//Size of the next regular block; grows as the arena fills up
+	size_t		nextBlockSize;
+} Arena;
+
+//Allocates an empty arena.  Returns NULL if malloc fails.
+Arena* createArena(void);
+
+//Returns size bytes of memory aligned for any type, or NULL if malloc fails.  Never freed individually.
+void* arenaAlloc(Arena* arena, size_t size);
+
+//Copies str into the arena
+char* arenaStrdup(Arena* arena, const char* str);
+
+//Copies at most n bytes of str into the arena and NUL-terminates the copy
+char* arenaStrndup(Arena* arena, const char* str, size_t n);
+
+//Frees every block of the arena and the arena itself
+void destroyArena(Arena* arena);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef _VCCACHE_H
+#define _VCCACHE_H
+
+#include <stddef.h>
+
+#include "VCParser.h"
+
+/*	Process-wide cache of parsed cards, so that repeated look-ups of the same file cost a stat call
+	instead of a parse.  Entries are keyed by path (as given, not canonicalized) plus the file's
+	modification time and size, and the least recently used ones are evicted once the cards in the
+	cache exceed the byte budget.  writeCard drops the entry of the file it writes.
+	All functions may be called from any thread; the cache has its own lock.
+*/
+
+#define CARD_CACHE_DEFAULT_BUDGET (16 * 1024 * 1024)
+
+//A card held by the cache.  It stays valid, even if evicted or invalidated, until it is released.
+typedef struct cachedCard CachedCard;
+
+/** Function to get the parsed card for a file, parsing it only if it is not cached or has changed.
+ *@pre fileName is not NULL
+ *@post On OK, *entry holds a card that must not be modified, and must be released with releaseCachedCard.
+		Failed parses are not cached.
+ *@return the error code of createCard
+ *@param fileName - the name of the input file
+		 entry - receives the cache entry
+ **/
+VCardErrorCode getCachedCard(const char* fileName, CachedCard** entry);
+
+//Returns the card of a cache entry
+const Card* cachedCardData(const CachedCard* entry);
+
+//Releases an entry returned by getCachedCard.  NULL is ignored.
+void releaseCachedCard(CachedCard* entry);
+
+//Drops the cached card of a file, if any.  Called by writeCard.
+void invalidateCachedCard(const char* fileName);
+
+//Sets the approximate number of bytes the cached cards may use, evicting as needed.  0 disables caching.
+void setCardCacheBudget(size_t bytes);
+
+//Drops every card that is not currently in use, and returns the unused pool memory (poolTrim)
+void clearCardCache(void);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _VCDIRECTORY_H
+#define _VCDIRECTORY_H
+
+#include <stddef.h>
+
+#include "VCParser.h"
+
+//Outcome of parsing and validating one file of a directory
+typedef struct parseResult {
+	//Full path of the file (directory + "/" + file name)
+	char*			path;
+
+	//Result of createCard, or of validateCard if the card parsed
+	VCardErrorCode	error;
+
+	//The parsed card if createCard succeeded (even if it failed validation), NULL otherwise
+	Card*			card;
+} ParseResult;
+
+/** Function to parse and validate every .vcf/.vcard file in a directory on a pool of worker threads.
+ *@pre dirName is not NULL
+ *@post *results holds one entry per file, sorted by path, and must be released with freeParseResults
+ *@return INV_FILE if the directory cannot be read, OTHER_ERROR if memory allocation fails, OK otherwise.
+		  Errors of individual files are reported in their ParseResult, not here.
+ *@param dirName - the directory to scan (not recursive)
+		 nthreads - number of worker threads; 0 or less uses one per online CPU
+		 callback - called once per file as soon as it is done, or NULL.  Calls are serialized, but come from
+					the worker threads.  The callback may take ownership of result->card by setting it to NULL.
+		 context - passed through to callback
+		 results - receives the result array
+		 count - receives the number of results
+ **/
+VCardErrorCode parseDirectory(const char* dirName, int nthreads,
+							  void (*callback)(ParseResult* result, void* context), void* context,
+							  ParseResult** results, size_t* count);
+
+/** Function to check every .vcf/.vcard file in a directory like parseDirectory, but with validateFile, so that
+	no card is built.  Every result's card is NULL.
+ *@return the same codes as parseDirectory
+ *@param dirName - the directory to scan (not recursive)
+		 nthreads - number of worker threads; 0 or less uses one per online CPU
+		 results - receives the result array, to be released with freeParseResults
+		 count - receives the number of results
+ **/
+VCardErrorCode validateDirectory(const char* dirName, int nthreads, ParseResult** results, size_t* count);
+
+//Frees the paths and cards of a result array and the array itself
+void freeParseResults(ParseResult* results, size_t count);
+
+#endif
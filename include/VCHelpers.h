@@ -1,17 +1,180 @@
 // MOHAMMED AFNAAN UDDIN
 // 1269872
 
+#ifndef _VCHELPERS_H
+#define _VCHELPERS_H
+
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "LinkedListAPI.h"
 #include "VCParser.h"
+#include "VCScan.h"
+
 
+// Checks the file extension: .vcf or .vcard, in any case, at the end of the name
+bool hasCardExtension(const char *fileName);
 
 // Adds a parameter to a property's parameter list, ensuring no duplicates
 void addParameter(Property *prop, const char *name, const char *value);
 
+// Parses one unfolded content line into newCard.  Reentrant: all state is in the arguments and the stack.
 VCardErrorCode createCardHelper(const char *line, Card *newCard, bool *fnFound);
+
+// Same as createCardHelper, and stores raw (the line as it was in the file) in whatever the line turns into
+VCardErrorCode createCardHelperRaw(const char *line, const char *raw, Card *newCard, bool *fnFound);
+
+// What a content line turns into once it has been split
+typedef enum lineKind {
+    LINE_IGNORED,   // no ':', or the BEGIN/END/VERSION lines
+    LINE_FN,        // the card's first FN
+    LINE_DATE,      // BDAY or ANNIVERSARY
+    LINE_PROPERTY   // anything else, which goes into optionalProperties
+} LineKind;
+
+/* Splits an indexed logical line and decides what it is, with the same rules for every parse mode.
+   Returns INV_PROP for an empty name or a misplaced FN, and INV_CARD for a date line without a ':'.
+*/
+VCardErrorCode classifyPropertyLine(const char *line, const StructuralIndex *index, bool fnFound, PropertySplit *split, PropertyId *id, LineKind *kind);
+// Checks the one rule for a content line that createCard applies before splitting it: a BDAY or ANNIVERSARY line
+// must have a ':'.  Returns INV_CARD or OK.  Projections check skipped lines with it.
+VCardErrorCode checkLineStructure(const char *line);
+
+// Finds the property name of a content line with the same group and parameter rules as splitPropertyLine,
+// without indexing the line.  Returns PROP_OTHER if the line has neither ':' nor ';'.
+PropertyId propertyIdOfLine(const char *line);
+
+// Where parseDateValue found the parts of a date-and-or-time value, without copying them
+typedef struct dateValue {
+    size_t dateLength;  // the date is value[0, dateLength)
+    size_t timeStart;   // the time is value[timeStart, timeStart + timeLength), with any offset but without a Z
+    size_t timeLength;
+    bool UTC;
+    uint64_t key;       // as dateTimeKey would compute it
+} DateValue;
+
+/* Parses a date-and-or-time value (e.g. 19850412, --0412, ---12, T102200, 19850412T102200-0500 or
+   T1022Z) in one pass, without allocating.  Returns INV_DT if the value is malformed, out of range or empty.
+*/
+VCardErrorCode parseDateValue(const char *value, size_t length, DateValue *result);
+
+// Checks that createCard can parse the value of a BDAY or ANNIVERSARY line of length bytes, which need not be
+// NUL-terminated.  Returns INV_DT or OK.
+VCardErrorCode checkDateLine(const char *line, size_t length, const PropertySplit *split);
+
+// Applies the DateTime rules of validateCard to the date that a BDAY or ANNIVERSARY line would be parsed into,
+// without building it.  Returns INV_DT or OK.
+VCardErrorCode validateDateLine(const char *line, const PropertySplit *split);
+
 // Checks if a parameter already exists in the parameter list
 bool parameterExists(List *parameters, const char *name, const char *value);
+
+// Property.rawOrder of a kept FN, BDAY or ANNIVERSARY line is RAW_ORDER_STEP times the number of optional properties before it, plus its rank among such lines there
+#define RAW_ORDER_STEP 16
+
+// Value of the made field of the Cards, Properties and DateTimes that the library allocates
+#define LIBRARY_MADE 0x56434d64u
+
+/* Clear the fields that the library sets and callers building objects by hand may not (Card.arena and index,
+   Property.raw and hash, DateTime.raw and key, ...) in an object the library did not make, and mark it as made,
+   so later calls can trust them.  Objects that are already marked are left alone.  adoptCard only adopts the
+   Card struct itself.
+*/
+void adoptCard(Card *card);
+void adoptProperty(Property *prop);
+void adoptDate(DateTime *dt);
+
+// The raw text and hash of a property, or NULL and 0 if the library did not make it
+const char *propertyRaw(const Property *prop);
+uint64_t propertyHash(const Property *prop);
+
+// The raw text and key of a date, or NULL and 0 if the library did not make it
+const char *dateRaw(const DateTime *dt);
+uint64_t dateKey(const DateTime *dt);
+
+// Allocates a Card with no FN, dates or optional properties yet, inside its own arena or with compact lists
+// if options ask for it (options may be NULL).  Returns NULL if malloc fails.
+Card *newEmptyCard(const CardParseOptions *options);
+
+// Allocation helpers for the parts of a card: they use the card's arena if it has one, the heap otherwise
+void *cardAlloc(Card *card, size_t size);
+char *cardStrdup(Card *card, const char *str);
+char *cardStrndup(Card *card, const char *str, size_t n);
+List *cardList(Card *card, char *(*printFunction)(void *toBePrinted), void (*deleteFunction)(void *toBeDeleted), int (*compareFunction)(const void *first, const void *second));
+
+// Growable buffer for one logical (unfolded) line.  Always NUL-terminated once data is allocated.
+typedef struct lineBuffer {
+    char *data;
+    size_t length;
+    size_t capacity;
+} LineBuffer;
+
+// Appends len bytes of str in amortised O(1) per byte.  Returns false if out of memory.
+bool lineBufferAppend(LineBuffer *buffer, const char *str, size_t len);
+
+// Reads cards from an open file or a memory buffer.  The buffers are reused from card to card.
+typedef struct cardReader {
+    // Source file, or NULL when reading from data
+    FILE *file;
+
+    // In-memory source and the offset of the next unread byte
+    const char *data;
+    size_t dataLength;
+    size_t dataOffset;
+
+    // Current physical line, as returned by getline, including its CRLF
+    char *line;
+    size_t lineCapacity;
+    size_t lineLength;
+
+    // Logical line being unfolded
+    LineBuffer logical;
+
+    // The physical lines of the logical line as they were in the file, CRLFs included.  Only kept if keepRaw is set.
+    LineBuffer raw;
+    bool keepRaw;
+
+    // Set to make the next readPhysicalLine return the current line again
+    bool unread;
+
+    // For readers of several cards: a BEGIN:VCARD line inside a card ends it with INV_CARD and is left unread
+    bool stopAtBegin;
+} CardReader;
+
+void initCardReader(CardReader *reader, FILE *file);
+
+// Reads from length bytes of data instead of a file.  data must stay valid while the reader is used.
+void initCardReaderFromBuffer(CardReader *reader, const char *data, size_t length);
+
+// Frees the reader's buffers.  Does not close the file.
+void freeCardReader(CardReader *reader);
+
+// Reads the next physical line of any length into reader->line.  Returns false at EOF.
+bool readPhysicalLine(CardReader *reader);
+
+// Writes a card in the vCard file format of writeCard into buf, like snprintf.  Returns the full length.
+// The card must have an FN value.
+size_t cardToFileTextInto(const Card *obj, char *buf, size_t cap);
+
+// Writes all of data to fd, retrying after short writes and signals.  Returns false on error.
+bool writeAll(int fd, const char *data, size_t length);
+
+// Creates an empty temporary file next to fileName, with the permissions of fileName if it exists.
+// Returns its descriptor and sets *tempName (freed by finishTempFile), or returns -1.
+int createTempFile(const char *fileName, char **tempName);
+
+// Closes a file from createTempFile and, if ok, syncs it as requested and renames it over fileName.
+// Otherwise, or if any of that fails, removes it and returns WRITE_ERROR.  Frees tempName.
+VCardErrorCode finishTempFile(int fd, char *tempName, const char *fileName, WriteSync sync, bool ok);
+
+/* Reads one BEGIN:VCARD ... END:VCARD block from the current position of the reader.
+   Leaves *obj NULL and returns OK if EOF is reached before a BEGIN:VCARD line.
+   options may be NULL for the defaults.
+   endConsumed is set once the END:VCARD line has been read, so callers can resync after an error.
+   A projection (options->properties) that stops early returns before END:VCARD, so it is only suitable for
+   readers that hold a single card.
+*/
+VCardErrorCode readNextCard(CardReader *reader, const CardParseOptions *options, Card **obj, bool skipBlankLines, bool *endConsumed);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef _VCINDEX_H
+#define _VCINDEX_H
+
+#include "VCParser.h"
+
+/*	Per-card index of properties by name and by group, so that looking up e.g. every TEL of a large
+	card does not scan optionalProperties.  The first lookup on a card builds its index, which modifies
+	the card, so cards shared between threads must be indexed with buildPropertyIndex first; the card
+	cache does this for the cards it holds.  Lookups on an indexed card only read it and may run on
+	several threads at once.  A card whose fn was replaced, or whose optionalProperties changed through the list API
+	(insertBack, deleteDataFromList, replaceFront, ...), since it was indexed is re-indexed on the next
+	lookup, which modifies the card.  Code that renames or regroups a property in place must call
+	dropPropertyIndex (or buildPropertyIndex) before the next lookup.  The parser's own output never
+	depends on the index.
+
+	The lists returned below belong to the index: they must not be modified or freed, and are only
+	valid until the card is changed or deleted.  They hold the card's fn first, if it matches, and
+	then the matching optionalProperties in card order.  They are LIST_VECTOR lists, so they must be
+	read with an iterator or getFromFront/getFromBack rather than through their head.
+*/
+
+/** Function to get the properties of a card with a given name, e.g. getProperties(card, "TEL").
+ *@pre card and name are not NULL
+ *@return a list of Property, or NULL if there are none (or the index could not be built for lack of memory)
+ *@param card - the card to search
+ *@param name - the property name, in any case
+ **/
+List* getProperties(Card* card, const char* name);
+
+//Same as getProperties, for a property ID other than PROP_OTHER
+List* getPropertiesById(Card* card, PropertyId id);
+
+/** Function to get the properties of a card that belong to a group, e.g. getGroup(card, "item1").
+ *@pre card and group are not NULL
+ *@return a list of Property, or NULL if the group has no members
+ *@param card - the card to search
+ *@param group - the group name, in any case
+ **/
+List* getGroup(Card* card, const char* group);
+
+//Builds the index of a card, replacing any old one.  Returns OTHER_ERROR if out of memory, leaving the card without an index.
+VCardErrorCode buildPropertyIndex(Card* card);
+
+//Frees the index of a card, if it has one.  The next lookup builds a new one.
+void dropPropertyIndex(Card* card);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _VCLAZY_H
+#define _VCLAZY_H
+
+#include <stddef.h>
+
+#include "VCParser.h"
+#include "VCView.h"
+
+/*	Lazy parse mode for large cards of which only a few fields are read.  Opening a LazyCard only
+	builds the line-offset index of a CardView (the ID and byte range of every property); a full
+	Property, with its parameter and value lists, is built the first time it is accessed and then
+	kept until closeLazyCard.  A LazyCard is changed by every access, so it must not be shared
+	between threads without a lock.
+*/
+
+typedef struct lazyCard {
+	//Index of the mapped file.  view->properties[i] describes property i.
+	CardView*	view;
+
+	/*	Owns everything materialized so far.  Its fn, birthday and anniversary are filled in on first
+		access, and materialized properties are kept in its optionalProperties in access order.
+	*/
+	Card*		card;
+
+	//Materialized view->properties[i], or NULL until it is first accessed.  view->count entries.
+	Property**	properties;
+} LazyCard;
+
+/** Function to open a vCard file in lazy mode.
+	Performs the same structural checks as createCard and returns the same error codes.
+ *@pre fileName is not NULL and has the correct extension
+ *@post On OK, *obj is a new LazyCard that must be released with closeLazyCard
+ *@return the error code indicating success or the error encountered when indexing the file
+ *@param fileName - the name of the input file
+		 obj - receives the new LazyCard
+ **/
+VCardErrorCode openLazyCard(const char* fileName, LazyCard** obj);
+
+//Frees a LazyCard, every property materialized from it and its mapping
+void closeLazyCard(LazyCard* obj);
+
+//Returns the index of the first property at or after start whose ID is id, or obj->view->count if there is none
+size_t findLazyProperty(const LazyCard* obj, PropertyId id, size_t start);
+
+/** Function to get the FN property of a lazy card, building it on first use.
+ *@return OK, or OTHER_ERROR if memory allocation fails
+ **/
+VCardErrorCode getLazyFN(LazyCard* obj, Property** prop);
+
+/** Function to get property i of a lazy card, building it on first use.  The property stays owned by obj.
+ *@pre i < obj->view->count
+ *@return OK, INV_PROP if i is out of range or is an ungrouped BDAY/ANNIVERSARY line (use getLazyDate),
+		  or OTHER_ERROR if memory allocation fails
+ **/
+VCardErrorCode getLazyProperty(LazyCard* obj, size_t i, Property** prop);
+
+/** Function to get the birthday (PROP_BDAY) or anniversary (PROP_ANNIVERSARY) of a lazy card, building it on first use.
+	As with createCard, the last such line of the card is used.
+ *@post *dt is NULL if the card has no such date
+ *@return OK, OTHER_ERROR if id is not a date property or memory allocation fails
+ **/
+VCardErrorCode getLazyDate(LazyCard* obj, PropertyId id, DateTime** dt);
+
+#endif
@@ -2,6 +2,7 @@
 #define _CARDPARSER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,8 +34,42 @@ typedef struct dt {
 	//Text value for the DateTime. Must be an empty string if DateTime is not text
 	char* 	text; 
 
+	//Original line in the file if the card was parsed with keepRaw and the date is unchanged (see Property.raw), or NULL
+	char*	raw;
+
+	//Only used with raw: where the line stood among the other lines of the card (see Property.rawOrder)
+	int		rawOrder;
+
+	/*	Set by the library in every DateTime it allocates, to a value that uninitialised memory does not hold by
+		chance.  In a DateTime built in some other way (e.g. with malloc), raw, rawOrder and key are ignored, so
+		callers only need to fill in the other fields.  The same holds for Property.made and Card.made.
+	*/
+	uint32_t	made;
+
+	/*	dateTimeKey of the date, set by the parser and makeDate, so that dates can be sorted and range-filtered
+		with integer comparisons.  0 for text dates.  compareDates computes it if it is 0 or the DateTime was not
+		made by the library.  Code that changes a parsed date must call markDateDirty.
+	*/
+	uint64_t	key;
+
 } DateTime;
 
+/*	Fields of a packed DateTime key.  From the most significant bits down, a key holds the year, month, day,
+	hour, minute and second, each stored as value + 1 so that 0 marks a part the date leaves unspecified,
+	then the UTC flag and the UTC offset.  Comparing keys as integers therefore orders dates by their fields
+	as written, with an unspecified part before every specified one (--0203 sorts before 19850203), and
+	times in different zones are only ordered by their zone when the fields are equal.
+*/
+typedef enum dateKeyField {
+	DATE_KEY_YEAR,
+	DATE_KEY_MONTH,
+	DATE_KEY_DAY,
+	DATE_KEY_HOUR,
+	DATE_KEY_MINUTE,
+	DATE_KEY_SECOND,
+	DATE_KEY_FIELDS
+} DateKeyField;
+
 
 //Represents a generic vCard parameter
 typedef struct param {
@@ -44,9 +79,61 @@ typedef struct param {
 	//Property description.  Must not be empty string.  Must not be NULL.
 	char*	value; 
 
+	//hashParameter of the parameter, set by the parser and makeParameter, or 0 if not known.  Parameters built by hand must set it to 0.
+	uint64_t	hash;
+
 } Parameter;
 
 
+/*	Known vCard 4.0 property names, so that code can switch on an integer instead of comparing strings.
+	PROP_OTHER covers extension (X-) and unrecognised names.
+*/
+typedef enum propId {
+	PROP_OTHER = 0,
+	PROP_BEGIN,
+	PROP_END,
+	PROP_SOURCE,
+	PROP_KIND,
+	PROP_XML,
+	PROP_FN,
+	PROP_N,
+	PROP_NICKNAME,
+	PROP_PHOTO,
+	PROP_BDAY,
+	PROP_ANNIVERSARY,
+	PROP_GENDER,
+	PROP_ADR,
+	PROP_TEL,
+	PROP_EMAIL,
+	PROP_IMPP,
+	PROP_LANG,
+	PROP_TZ,
+	PROP_GEO,
+	PROP_TITLE,
+	PROP_ROLE,
+	PROP_LOGO,
+	PROP_ORG,
+	PROP_MEMBER,
+	PROP_RELATED,
+	PROP_CATEGORIES,
+	PROP_NOTE,
+	PROP_PRODID,
+	PROP_REV,
+	PROP_SOUND,
+	PROP_UID,
+	PROP_CLIENTPIDMAP,
+	PROP_URL,
+	PROP_VERSION,
+	PROP_KEY,
+	PROP_FBURL,
+	PROP_CALADRURI,
+	PROP_CALURI,
+	PROP_COUNT
+} PropertyId;
+
+//Bit of a property ID in a property mask, e.g. PROPERTY_BIT(PROP_FN) | PROPERTY_BIT(PROP_BDAY)
+#define PROPERTY_BIT(id) ((uint64_t)1 << (id))
+
 //Represents a generic vCard property
 typedef struct prop {
 	//Property name.  Must not be empty string.  Must not be NULL.
@@ -55,6 +142,12 @@ typedef struct prop {
 	//Group name.  Groups are optional, so this may be an empty string.  Must not be NULL.
 	char* 		group;
 
+	/*	ID of the name, matched case-insensitively.  Set by the parser and makeProperty, and by the index and
+		CardStore in Properties built in other ways.  Read it with propertyIdOf, which also handles a Property
+		that none of them has seen.  Code that renames a Property must update it.
+	*/
+	PropertyId	id;
+
 	/* 	List of property parameters.  All objects in the list will be of type Parameter.
 		List may be empty if property parameters are absent.  List must never be NULL.  
     */
@@ -66,6 +159,37 @@ typedef struct prop {
 	*/
 	List*		values; 
 
+	/*	Original text of the property in the file, folding and CRLF included, if the card was parsed with
+		keepRaw.  writeCard copies it verbatim instead of rendering the property.  Code that changes a parsed
+		property must call markPropertyDirty, which drops it.  NULL otherwise, as makeProperty leaves it.
+		Ignored, like rawOrder and hash, in a Property that the library did not allocate (see made).
+	*/
+	char*		raw;
+
+	/*	Only used with raw, in a card's fn: where the line stood among the card's optionalProperties, so that
+		writeCard puts an unchanged FN, BDAY or ANNIVERSARY back between the same lines.  Lines whose text is
+		not kept are written first, as FN, BDAY, ANNIVERSARY.
+	*/
+	int			rawOrder;
+
+	//Marks a Property allocated by the library (see DateTime.made).  id, raw, rawOrder and hash are only read in such Properties.
+	uint32_t	made;
+
+	/*	hashProperty of the property, set by the parser and by markPropertyDirty, or 0 if not known.
+		propertiesEqual and PropertySet (VCPropertySet.h) use it to reject unequal properties without comparing
+		any strings.  makeProperty leaves it 0, since the property is still empty, and code that changes a parsed
+		property must call markPropertyDirty.  A stale hash makes equal properties compare unequal.
+	*/
+	uint64_t	hash;
+
+	/*	Storage of parameters and values of Properties parsed with CardParseOptions.compactLists (and no arena):
+		parameters and values point to these, so that the lists, and their first LIST_INLINE_ITEMS elements,
+		need no allocations of their own.  Always use the two pointers above, and never pass them to freeList.
+		A Property must not be copied by value.  Other Properties leave them unused.
+	*/
+	List		parameterList;
+	List		valueList;
+
 } Property;
 
 
@@ -96,14 +220,140 @@ typedef struct vCard {
 	*/
 	DateTime* 	anniversary;
 
+	/*	If not NULL, every part of the card - including the Card struct itself - was allocated from this
+		arena and deleteCard releases it all at once.  Strings and lists in such a card must not be freed
+		individually; allocate replacements with arenaStrdup(card->arena, ...) instead.
+		NULL in cards from makeCard.
+	*/
+	struct arena*	arena;
+
+	//Index of the properties by name and group (see VCIndex.h), or NULL
+	struct propertyIndex*	index;
+
+	//Set when the card was parsed with CardParseOptions.compactLists; only read while the parser adds to the card
+	bool		compactLists;
+
+	//Marks a Card allocated by the library (see DateTime.made).  The three fields above are only read in such Cards.
+	uint32_t	made;
 
 } Card;
 
+//Options for createCardWithOptions.  Zero-initialize and set the fields that are needed.
+typedef struct cardParseOptions {
+	//Allocate the card and everything in it from a single arena (see Card.arena)
+	bool		useArena;
+
+	/*	Mask of PROPERTY_BITs to parse, or 0 for all of them.  FN is always parsed, since every card needs one.
+		Lines of other properties are skipped without being split, checked or allocated, and if only FN, BDAY
+		and ANNIVERSARY are requested, the lines after they have all been found are skipped as well (keeping the
+		first of each).  Skipped lines are still read up to END:VCARD and checked for their structure (CRLF
+		endings, VERSION, END, and a ':' in BDAY and ANNIVERSARY lines), so every INV_CARD of createCard is
+		still found, but a skipped line that createCard would reject as INV_PROP or INV_DT goes unnoticed.
+		Use validateFile to check those too.
+	*/
+	uint64_t	properties;
+
+	/*	Keep the original text of every property (see Property.raw), so unchanged lines are written back byte for
+		byte and in their original order.  An unchanged card therefore round-trips exactly, unless VERSION was
+		not its second line or it had more than one ungrouped BDAY or ANNIVERSARY (only the last is kept).
+	*/
+	bool		keepRaw;
+
+	/*	Store the parameter and value lists of each property inside it (see Property.parameterList), which saves
+		most of the allocations of a property, and make every list of the card a LIST_VECTOR.  Such lists have
+		no Nodes and the embedded ones must not be freed with freeList; deleteProperty and deleteCard handle
+		them.  Off by default, so that every List* of a parsed card is a separate, linked list.
+	*/
+	bool		compactLists;
+} CardParseOptions;
+
+/*	Thread safety: the parser keeps no global or static mutable state; every buffer lives in the caller's
+	stack frame, a CardReader or the Card being built.  createCard, createCardWithOptions,
+	createCardFromBuffer, createCardHelper, cardToString, validateCard and writeCard are therefore reentrant
+	and may run on any number of threads at once, as long as no Card is modified by one thread while another
+	is using it, and no two threads write the same file.  The card cache (VCCache.h) is the only shared state
+	and has its own lock.
+*/
+
 // ************* Card parser functions - MUST be implemented ***************
 VCardErrorCode createCard(char* fileName, Card** obj);
 void deleteCard(Card* obj);
+VCardErrorCode createCardWithOptions(const char* fileName, const CardParseOptions* options, Card** obj);
+
+/** Function to parse a card held in memory, e.g. an upload or a decompressed buffer, with the same rules as createCard.
+ *@pre data points to length readable bytes.  It does not need to be NUL-terminated.
+ *@post On OK, *obj is a new Card owned by the caller.  data is not modified or kept.
+ *@return INV_FILE if data or obj is NULL, otherwise the same codes as createCard
+ *@param data - the contents of a .vcf file
+		 length - the number of bytes in data
+		 obj - receives the new card
+ **/
+VCardErrorCode createCardFromBuffer(const char* data, size_t length, Card** obj);
+
 char* cardToString(const Card* obj);
+
+/** Function to write the cardToString text of a card into a caller-provided buffer, like snprintf, without allocating.
+ *@post buf holds as much of the text as fits in cap - 1 bytes, NUL-terminated if cap > 0
+ *@return the length of the full text, not counting the NUL.  The text was truncated if this is >= cap.
+ *@param obj - the card to print
+		 buf - the destination, may be NULL if cap is 0
+		 cap - size of buf in bytes
+ **/
+size_t cardToStringInto(const Card* obj, char* buf, size_t cap);
+
 char* errorToString(VCardErrorCode err);
+
+//Records that a property of card was changed, so writeCard renders it instead of copying its original text, and updates its hashes
+void markPropertyDirty(Card* card, Property* prop);
+
+//Same as markPropertyDirty, for card->birthday or card->anniversary.  Also updates its key.
+void markDateDirty(Card* card, DateTime* dt);
+
+//Replaces the first value of a property of card with a copy of value and marks the property dirty.  Returns OTHER_ERROR if out of memory.
+VCardErrorCode setPropertyValue(Card* card, Property* prop, const char* value);
+
+/** Function to compute a 64-bit hash of a property's group, name, parameters and values.
+	Properties for which compareProperties returns 0 have the same hash.
+ *@return the hash, which is never 0
+ **/
+uint64_t hashProperty(const Property* prop);
+
+//Same as hashProperty, for the name and value of a parameter
+uint64_t hashParameter(const Parameter* param);
+
+/** Function to test two properties for equality, as compareProperties(first, second) == 0.
+	If both have a hash, properties whose hashes differ are rejected without comparing any strings.
+ **/
+bool propertiesEqual(const Property* first, const Property* second);
+
+//Looks up a property name (not NUL-terminated, any case) with a perfect hash.  Returns PROP_OTHER if it is not a vCard 4.0 name.
+PropertyId propertyIdFromName(const char* name, size_t length);
+
+//Returns the upper-case name of a property ID, or "" for PROP_OTHER
+const char* propertyIdToName(PropertyId id);
+
+//Returns prop->id, or looks prop->name up if the library did not make prop (see Property.made)
+PropertyId propertyIdOf(const Property* prop);
+
+/*	Constructors for building a card by hand.  They set every field that the parser sets besides the ones
+	a caller fills in (id, hash, key, ...).  Structs allocated in some other way work as well, since the
+	library ignores those fields in objects it did not make.  Each returns NULL if out of memory.
+*/
+
+//Allocates a card whose FN has a copy of fn as its value, with no other properties or dates
+Card* makeCard(const char* fn);
+
+//Allocates a property with copies of group ("" for none) and name, and empty parameter and value lists
+Property* makeProperty(const char* group, const char* name);
+
+//Allocates a parameter with copies of name and value, and its hash
+Parameter* makeParameter(const char* name, const char* value);
+
+//Allocates a date-and-or-time with copies of date and time, either of which may be "" if unspecified
+DateTime* makeDate(const char* date, const char* time, bool UTC);
+
+//Allocates a text date, e.g. "circa 1800"
+DateTime* makeTextDate(const char* text);
 // *************************************************************************
 
 // ************* List helper functions - MUST be implemented *************** 
@@ -119,6 +369,22 @@ void deleteValue(void* toBeDeleted);
 int compareValues(const void* first,const void* second);
 char* valueToString(void* val);
 
+/** Function to compute the packed key of a structured DateTime from its date, time and UTC fields.
+	Accepts the vCard 4.0 forms YYYYMMDD, YYYY-MM, YYYY, --MMDD, --MM and ---DD for the date, and HHMMSS, HHMM,
+	HH, -MMSS, -MM and --SS for the time, optionally followed by a +hh, +hhmm, -hh or -hhmm UTC offset.
+ *@return the key, which is never 0, or 0 for a text date or one that is not in one of these forms
+ **/
+uint64_t dateTimeKey(const DateTime* dt);
+
+//Orders two keys from dateTimeKey: < 0, 0 or > 0 like strcmp
+int compareDateKeys(uint64_t first, uint64_t second);
+
+//Returns a field of a key, or -1 if the date leaves it unspecified
+int dateKeyField(uint64_t key, DateKeyField field);
+
+//Returns the UTC offset of a key in minutes, e.g. -480 for -0800, and sets *specified to whether the date has one (0 for Z)
+int dateKeyOffset(uint64_t key, bool* specified);
+
 void deleteDate(void* toBeDeleted);
 int compareDates(const void* first,const void* second);
 char* dateToString(void* date);
@@ -137,6 +403,29 @@ char* dateToString(void* date);
  **/
  VCardErrorCode writeCard(const char* fileName, const Card* obj);
 
+ //When writeCardWithOptions forces the new file to disk before reporting success
+ typedef enum writeSync {
+	//Leave it to the OS.  A crash may lose the new file, but never leaves a partly written one.
+	WRITE_SYNC_NONE,
+	//fsync the file before it replaces the old one
+	WRITE_SYNC_FILE,
+	//Also fsync the directory, so the replacement itself survives a crash
+	WRITE_SYNC_FILE_AND_DIRECTORY
+ } WriteSync;
+
+ //Options for writeCardWithOptions.  Zero-initialize and set the fields that are needed.
+ typedef struct cardWriteOptions {
+	WriteSync	sync;
+ } CardWriteOptions;
+
+ /** Function to write a Card like writeCard, with a choice of fsync policy.  The card is rendered into one
+	buffer, written to a temporary file next to fileName with a single write, and renamed over fileName,
+	so the file is always either the old or the new card.  writeCard uses WRITE_SYNC_NONE.
+  *@return the same codes as writeCard; WRITE_ERROR if writing, syncing or renaming fails
+  *@param options - may be NULL for the defaults
+  **/
+ VCardErrorCode writeCardWithOptions(const char* fileName, const Card* obj, const CardWriteOptions* options);
+
 
  /** Function to writing a Card object into a file in vCard format.
   *@pre Card object exists, and is not NULL.
@@ -147,4 +436,77 @@ char* dateToString(void* date);
   **/
  VCardErrorCode validateCard(const Card* obj);
 
+ /** Function to validate a vCard file in a single streaming pass, without building a Card.
+  *@pre fileName is not NULL
+  *@post No Card is created and nothing is allocated per property
+  *@return the same error code as createCard followed, if that succeeds, by validateCard
+  *@param fileName - the name of the file to check
+  **/
+ VCardErrorCode validateFile(const char* fileName);
+
+ //Same as validateFile, for the contents of a file held in memory (see createCardFromBuffer)
+ VCardErrorCode validateBuffer(const char* data, size_t length);
+
+// ************* Streaming reader for multi-card files ***************
+
+//Opaque handle for reading the cards of a multi-card .vcf/.vcard export one at a time
+typedef struct cardStream CardStream;
+
+/** Function to open a multi-card vCard file for sequential reading.
+ *@pre fileName is not NULL and has the correct extension
+ *@post On success, *stream is ready for nextCard and must be released with closeCardStream
+ *@return INV_FILE if the file cannot be opened, OTHER_ERROR if memory allocation fails, OK otherwise
+ *@param fileName - the name of the input file
+		 stream - receives the new stream
+ **/
+VCardErrorCode openCardStream(const char* fileName, CardStream** stream);
+
+/** Function to read the next card from a stream.  Only one card is held in memory at a time,
+	so the size of the file does not matter.  Blank lines between cards are ignored.
+ *@pre stream was returned by openCardStream
+ *@post On OK, *obj is a new Card owned by the caller, or NULL once the end of the file has been reached.
+		On error, *obj is NULL and the stream has skipped to the next BEGIN:VCARD line, so reading
+		can continue with the next card.  A card that reaches another BEGIN:VCARD before its END:VCARD
+		is INV_CARD, and a line outside any card is reported as INV_CARD on its own.
+ *@return the error code of the card that was read
+ *@param stream - the stream to read from
+		 obj - receives the next card
+ **/
+VCardErrorCode nextCard(CardStream* stream, Card** obj);
+
+//Closes the file behind a stream and frees the stream.  Cards already returned are not affected.
+void closeCardStream(CardStream* stream);
+
+// ************* Batch writer for multi-card files ***************
+
+//Opaque handle for writing many cards into one .vcf/.vcard file
+typedef struct cardWriter CardWriter;
+
+/** Function to start writing a multi-card vCard file.  Cards are rendered into a large buffer that is
+	written out in big chunks to a temporary file, which replaces fileName when the writer is closed.
+ *@pre fileName is not NULL and has the correct extension
+ *@post On success, *writer is ready for appendCard and must be finished with closeCardWriter or abortCardWriter
+ *@return INV_FILE if the extension is wrong or the file cannot be created, OTHER_ERROR if memory allocation fails, OK otherwise
+ *@param fileName - the name of the output file
+		 options - sync policy applied on close, may be NULL for the defaults
+		 writer - receives the new writer
+ **/
+VCardErrorCode openCardWriter(const char* fileName, const CardWriteOptions* options, CardWriter** writer);
+
+/** Function to add a card to the end of a writer's file, in the same format as writeCard.
+ *@return INV_CARD if the card has no FN (it is then skipped), WRITE_ERROR if writing failed, OK otherwise
+ **/
+VCardErrorCode appendCard(CardWriter* writer, const Card* obj);
+
+//Writes out what is buffered, replaces the target file and frees the writer.  Returns WRITE_ERROR if any write failed.
+VCardErrorCode closeCardWriter(CardWriter* writer);
+
+//Frees a writer without touching the target file
+void abortCardWriter(CardWriter* writer);
+
+/** Function to write n cards into one file.  The file is only replaced if every card could be written.
+ *@return INV_CARD if a card has no FN, otherwise the same codes as openCardWriter and closeCardWriter
+ **/
+VCardErrorCode writeCards(const char* fileName, Card** cards, size_t n);
+
 #endif	
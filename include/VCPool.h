@@ -0,0 +1,42 @@
+#ifndef _VCPOOL_H
+#define _VCPOOL_H
+
+#include <stddef.h>
+
+/*	Thread-local pools of small fixed-size objects, used for parsed Properties, list heads, list nodes
+	and the first element array of vector lists.  Objects are carved out of 64 KB slabs, and a freed object goes
+	on a free list of the freeing thread, so allocating and freeing them does not call malloc or free
+	and only takes a lock when a thread runs out of free objects or has too many.  Objects may be freed on a
+	different thread than the one that allocated them: a thread keeps at most 64 KB of free objects of each
+	size and hands the rest, in batches, to a shared depot that threads which run out take from.  The free
+	lists of a thread that exits go to the depot too.
+	Slabs stay allocated until poolTrim returns the unused ones to the system.
+	Build with -DPOOL_USE_MALLOC to allocate every object with malloc instead (e.g. for memory
+	checkers, which can not see use-after-free inside a slab).
+*/
+
+//Largest object size served by the pools
+#define POOL_MAX_OBJECT 256
+
+/** Function to allocate an object from the pool of its size.
+ *@pre 0 < size <= POOL_MAX_OBJECT
+ *@return memory aligned for any pointer or integer type, or NULL if out of memory
+ *@param size - the size of the object
+ **/
+void* poolAlloc(size_t size);
+
+/** Function to return an object to its pool.
+ *@pre object was returned by poolAlloc with the same size, and is not used any more.  NULL is ignored.
+ *@param object - the object to free
+ *@param size - the size it was allocated with
+ **/
+void poolFree(void* object, size_t size);
+
+/** Function to return the memory of unused slabs to the system, e.g. after deleting many cards.
+	Moves the free objects of the calling thread to the depot first.  Objects on the free lists of other
+	threads keep their slabs allocated.
+ *@return the number of bytes freed, 0 with POOL_USE_MALLOC
+ **/
+size_t poolTrim(void);
+
+#endif
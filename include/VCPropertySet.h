@@ -0,0 +1,37 @@
+#ifndef _VCPROPERTYSET_H
+#define _VCPROPERTYSET_H
+
+#include <stddef.h>
+
+#include "VCParser.h"
+
+/*	Hash set of properties, for removing duplicate properties, e.g. when merging the properties of
+	two contacts.  Two properties are the same if propertiesEqual says so.  Lookups use Property.hash
+	(or hashProperty, for properties without one), so only properties with equal hashes are compared.
+	The set only refers to the properties, which must stay unchanged while they are in it.
+*/
+
+typedef struct propertySet PropertySet;
+
+//Allocates an empty set.  Returns NULL if out of memory.
+PropertySet* createPropertySet(void);
+
+//Frees a set, but not the properties in it.  NULL is ignored.
+void freePropertySet(PropertySet* set);
+
+/** Function to add a property to a set unless an equal one is already in it.
+ *@post *added is true if prop was added, false if the set already held an equal property
+ *@return OK, or OTHER_ERROR if out of memory (prop is then not added)
+ *@param set - the set
+ *@param prop - the property to add
+ *@param added - receives whether prop was new
+ **/
+VCardErrorCode addToPropertySet(PropertySet* set, const Property* prop, bool* added);
+
+//Returns the property of the set that equals prop, or NULL if there is none
+const Property* findInPropertySet(const PropertySet* set, const Property* prop);
+
+//Returns the number of properties in a set
+size_t propertySetSize(const PropertySet* set);
+
+#endif
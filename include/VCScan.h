@@ -0,0 +1,71 @@
+#ifndef _VCSCAN_H
+#define _VCSCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "VCParser.h"
+
+/*	Structural scanner for content lines.  One vectorized pass (AVX2 or SSE2 where available,
+	a table lookup otherwise) records the offset of every ':' ';' ',' '.' '=' '\' CR and LF in a
+	line.  Splitting a property then only walks that short list instead of re-searching the line.
+*/
+
+#define STRUCTURAL_INLINE_POSITIONS 64
+
+typedef struct structuralIndex {
+	//Offsets of the structural characters, in increasing order
+	uint32_t*	positions;
+	size_t		count;
+	size_t		capacity;
+
+	//Storage for short lines, so most lines need no allocation
+	uint32_t	inlinePositions[STRUCTURAL_INLINE_POSITIONS];
+} StructuralIndex;
+
+//Offsets of the parts of "[group.]name[;parameters]:value" within a line
+typedef struct propertySplit {
+	//Group is [0, nameStart - 1) when hasGroup is set
+	bool		hasGroup;
+	size_t		nameStart;
+	size_t		nameEnd;
+
+	//Parameters are [nameEnd + 1, colon) when hasParameters is set
+	bool		hasParameters;
+	size_t		colon;
+
+	//Position in the index of the colon, so later passes can resume from there
+	size_t		colonEntry;
+} PropertySplit;
+
+void initStructuralIndex(StructuralIndex* index);
+void freeStructuralIndex(StructuralIndex* index);
+
+//Indexes length bytes of line, replacing previous contents.  Returns false if out of memory.
+bool scanStructural(const char* line, size_t length, StructuralIndex* index);
+
+/** Splits an indexed line into group, name, parameters and value.  The group dot is only
+	recognised before the first ';'.
+ *@return OK, INV_PROP if the name is empty, or OTHER_ERROR if the line has no ':'
+ **/
+VCardErrorCode splitPropertyLine(const char* line, const StructuralIndex* index, PropertySplit* split);
+
+/** Calls onParameter for each "name=value" token of the parameter section.  Empty tokens
+	(";;") are skipped.  onParameter may be NULL to only check the syntax.
+ *@return INV_PROP if a token has no '=' or an empty name or value, otherwise OK or the first
+		  error returned by onParameter
+ **/
+VCardErrorCode forEachParameter(const char* line, const StructuralIndex* index, const PropertySplit* split,
+								VCardErrorCode (*onParameter)(void* context, const char* name, size_t nameLen, const char* value, size_t valueLen),
+								void* context);
+
+/** Calls onValue for each delimiter-separated value after the colon, up to length.
+	A delimiter escaped with a backslash does not split.
+ *@return OK or the first error returned by onValue
+ **/
+VCardErrorCode forEachValue(const char* line, size_t length, const StructuralIndex* index, const PropertySplit* split, char delimiter,
+							VCardErrorCode (*onValue)(void* context, const char* value, size_t valueLen),
+							void* context);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef _VCSTORE_H
+#define _VCSTORE_H
+
+#include <stddef.h>
+
+#include "VCParser.h"
+
+/*	In-memory collection of cards with secondary indexes, for answering contact lookups without parsing
+	files again.  FN, EMAIL and TEL values are kept in hash tables and N family names in a balanced tree,
+	so adding, updating, removing and looking up a card take O(1) (hash indexes) or O(log n) (family
+	names), whatever the number of cards that share a key.  FN, EMAIL and family names match in any case;
+	TEL values match on their digits and a leading '+' only, so "+1 (519) 555-0100" finds
+	"tel:+1-519-555-0100".
+
+	The store owns the cards added to it and deletes them in freeCardStore.  A card that is changed while
+	in the store must be passed to updateInCardStore before the next lookup.  The store is not
+	synchronized: callers that share one between threads must lock around every call.
+*/
+
+typedef struct cardStore CardStore;
+
+//The hash indexes of a store
+typedef enum storeIndex {
+	STORE_BY_FN,
+	STORE_BY_EMAIL,
+	STORE_BY_TEL,
+	STORE_INDEXES
+} StoreIndex;
+
+//Allocates an empty store.  Returns NULL if out of memory.
+CardStore* createCardStore(void);
+
+//Deletes every card of a store, frees the store and returns the unused pool memory (poolTrim).  NULL is ignored.
+void freeCardStore(CardStore* store);
+
+/** Function to add a card to a store and index its FN, EMAIL, TEL and N values.
+ *@pre store is not NULL
+ *@post On success the store owns card.  Otherwise the card is unchanged and still belongs to the caller.
+ *@return OK, INV_CARD if card is NULL or already in the store, or OTHER_ERROR if out of memory
+ *@param store - the store
+ *@param card - the card to add
+ **/
+VCardErrorCode addToCardStore(CardStore* store, Card* card);
+
+/** Function to re-index a card of a store after its FN, EMAIL, TEL or N properties changed.
+ *@pre store is not NULL
+ *@post On OTHER_ERROR the card has been removed from the store and belongs to the caller again
+ *@return OK, INV_CARD if card is not in the store, or OTHER_ERROR if out of memory
+ *@param store - the store
+ *@param card - the changed card
+ **/
+VCardErrorCode updateInCardStore(CardStore* store, Card* card);
+
+//Removes a card from a store without deleting it; the card belongs to the caller again.  Returns false if it was not in the store.
+bool removeFromCardStore(CardStore* store, Card* card);
+
+/** Function to look up the cards that have a given FN, EMAIL or TEL value.
+ *@pre store and key are not NULL
+ *@return a list of Card, in no particular order, or NULL if there are none.  The list belongs to the
+		  store: it must not be modified or freed, and is only valid until the store is next changed.
+		  It is a LIST_VECTOR list, so read it with an iterator rather than through its head.
+ *@param store - the store
+ *@param index - which of the values to match
+ *@param key - the value to look for
+ **/
+List* findInCardStore(const CardStore* store, StoreIndex index, const char* key);
+
+/** Function to visit the cards whose N family name lies in a range, in family name order.
+ *@pre store and visit are not NULL
+ *@post visit has been called for each card in the range, until it set *stop to true
+ *@param store - the store
+ *@param from - the lowest family name to visit, or NULL for no lower bound
+ *@param to - the highest family name to visit, or NULL for no upper bound.  Use from == to for one name.
+ *@param visit - called with each card; cards without an N property are never visited
+ *@param context - passed through to visit
+ **/
+void visitFamilyRange(const CardStore* store, const char* from, const char* to,
+					  void (*visit)(Card* card, void* context, bool* stop), void* context);
+
+//Returns the number of cards in a store
+size_t cardStoreSize(const CardStore* store);
+
+#endif
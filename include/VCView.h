@@ -0,0 +1,90 @@
+#ifndef _VCVIEW_H
+#define _VCVIEW_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "VCParser.h"
+
+/*	Read-only, zero-copy parse mode.  The file is memory-mapped and every field of a property
+	is a (pointer, length) view into the mapping - nothing is copied or allocated per property.
+	Views are only valid while the CardView that produced them is open.  Use copyView or
+	cardViewToCard to get heap copies that can be kept or mutated.
+*/
+
+//A (pointer, length) slice of the mapped file.  Not NUL-terminated.
+typedef struct strView {
+	const char*	data;
+	size_t		length;
+} StrView;
+
+//Represents one logical (unfolded) content line of a card
+typedef struct propertyView {
+	//The whole logical line, from the group/name up to (not including) the final CRLF
+	StrView		line;
+
+	//Group name.  Empty view if the property has no group.
+	StrView		group;
+
+	//Property name.  Never empty.
+	StrView		name;
+
+	//ID of the name, PROP_OTHER for extensions
+	PropertyId	id;
+
+	//Raw parameter text after the first ';', e.g. "TYPE=work;PREF=1".  Empty view if absent.
+	StrView		parameters;
+
+	//Raw value text after the first ':'
+	StrView		value;
+
+	/*	True if the line was folded in the file.  The views then still contain the CRLF + space/tab
+		continuation sequences, which copyView removes.
+	*/
+	bool		folded;
+} PropertyView;
+
+//A card parsed in view mode
+typedef struct cardView {
+	//Mapped file contents
+	const char*		data;
+	size_t			length;
+
+	//The FN property, i.e. the first FN line in the card
+	PropertyView	fn;
+
+	//All other content lines in file order, including BDAY and ANNIVERSARY
+	PropertyView*	properties;
+	size_t			count;
+	size_t			capacity;
+} CardView;
+
+/** Function to memory-map a vCard file and parse it in view mode.
+	Performs the same structural checks as createCard and returns the same error codes.
+ *@pre fileName is not NULL and has the correct extension
+ *@post On OK, *obj is a new CardView that must be released with closeCardView
+ *@return the error code indicating success or the error encountered when parsing the file
+ *@param fileName - the name of the input file
+		 obj - receives the new CardView
+ **/
+VCardErrorCode openCardView(const char* fileName, CardView** obj);
+
+//Unmaps the file behind a CardView and frees it.  All views into it become invalid.
+void closeCardView(CardView* obj);
+
+//Returns a NUL-terminated heap copy of a view with any line folding removed.  Must be freed by the caller.
+char* copyView(StrView view);
+
+//Returns true if the view is exactly equal to str, ignoring ASCII case
+bool viewEqualsIgnoreCase(StrView view, const char* str);
+
+/** Function to build a regular, mutable Card from a CardView, copying every string.
+ *@pre obj was returned by openCardView
+ *@post On OK, *card is a new Card owned by the caller and independent of the mapping
+ *@return the error code indicating success or the error encountered when building the Card
+ *@param obj - the view to copy
+		 card - receives the new Card
+ **/
+VCardErrorCode cardViewToCard(const CardView* obj, Card** card);
+
+#endif
@@ -1,6 +1,11 @@
 #include "LinkedListAPI.h"
+#include "VCArena.h"
+#include "VCPool.h"
 #include "assert.h"
 
+// Capacity of the first element array of a vector list, once it outgrows its inline items
+#define LIST_FIRST_CAPACITY (LIST_INLINE_ITEMS * 2)
+
 /** Function to initialize the list metadata head to the appropriate function pointers. Allocates memory to the struct.
  *@return pointer to the list head
  *@param printFunction function pointer to print a single node of the list
@@ -8,26 +13,140 @@
  *@param compareFunction function pointer to compare two nodes of the list in order to test for equality or order
  **/
 List *initializeList(char *(*printFunction)(void *toBePrinted), void (*deleteFunction)(void *toBeDeleted), int (*compareFunction)(const void *first, const void *second))
+{
+	return initializeListWithStorage(LIST_LINKED, printFunction, deleteFunction, compareFunction);
+}
+
+List *initializeListWithStorage(ListStorage storage, char *(*printFunction)(void *toBePrinted), void (*deleteFunction)(void *toBeDeleted), int (*compareFunction)(const void *first, const void *second))
+{
+	List *tmpList = poolAlloc(sizeof(List));
+	if (tmpList == NULL)
+	{
+		return NULL;
+	}
+
+	initializeListInPlace(tmpList, storage, printFunction, deleteFunction, compareFunction);
+
+	return tmpList;
+}
+
+void initializeListInPlace(List *list, ListStorage storage, char *(*printFunction)(void *toBePrinted), void (*deleteFunction)(void *toBeDeleted), int (*compareFunction)(const void *first, const void *second))
 {
 	// Asserts create a partial function...
+	assert(list != NULL);
 	assert(printFunction != NULL);
 	assert(deleteFunction != NULL);
 	assert(compareFunction != NULL);
 
-	List *tmpList = malloc(sizeof(List));
+	list->head = NULL;
+	list->tail = NULL;
+
+	list->length = 0;
+	list->changes = 0;
+
+	list->deleteData = deleteFunction;
+	list->compare = compareFunction;
+	list->printData = printFunction;
 
-	tmpList->head = NULL;
-	tmpList->tail = NULL;
+	list->arena = NULL;
 
-	tmpList->length = 0;
+	list->storage = storage;
+	list->items = (storage == LIST_VECTOR) ? list->inlineItems : NULL;
+	list->capacity = (storage == LIST_VECTOR) ? LIST_INLINE_ITEMS : 0;
+}
 
-	tmpList->deleteData = deleteFunction;
-	tmpList->compare = compareFunction;
-	tmpList->printData = printFunction;
+List *initializeListInArena(Arena *arena, char *(*printFunction)(void *toBePrinted), void (*deleteFunction)(void *toBeDeleted), int (*compareFunction)(const void *first, const void *second))
+{
+	assert(arena != NULL);
+
+	List *tmpList = arenaAlloc(arena, sizeof(List));
+	if (tmpList == NULL)
+	{
+		return NULL;
+	}
+
+	initializeListInPlace(tmpList, LIST_LINKED, printFunction, deleteFunction, compareFunction);
+	tmpList->arena = arena;
 
 	return tmpList;
 }
 
+// Allocates a node from the list's arena if it has one, from the node pool otherwise
+static Node *newListNode(List *list, void *data)
+{
+	Node *tmpNode = (list->arena == NULL) ? poolAlloc(sizeof(Node)) : arenaAlloc(list->arena, sizeof(Node));
+	if (tmpNode == NULL)
+	{
+		return NULL;
+	}
+
+	tmpNode->data = data;
+	tmpNode->previous = NULL;
+	tmpNode->next = NULL;
+
+	return tmpNode;
+}
+
+// Frees the element array of a vector list
+static void freeItems(List *list)
+{
+	if (list->items == list->inlineItems)
+	{
+		return;
+	}
+
+	if (list->capacity == LIST_FIRST_CAPACITY)
+	{
+		poolFree(list->items, sizeof(void *) * LIST_FIRST_CAPACITY);
+	}
+	else
+	{
+		free(list->items);
+	}
+}
+
+// Makes room for one more element in a vector list.  Returns false if out of memory.
+static bool reserveItem(List *list)
+{
+	if (list->length < list->capacity)
+	{
+		return true;
+	}
+
+	// Most lists stay short, so the first array comes from the pool and only bigger ones from malloc
+	int newCapacity = list->capacity * 2;
+	void **grown = (newCapacity == LIST_FIRST_CAPACITY) ? poolAlloc(sizeof(void *) * LIST_FIRST_CAPACITY) : malloc(newCapacity * sizeof(void *));
+	if (grown == NULL)
+	{
+		return false;
+	}
+
+	if (list->length > 0)
+	{
+		memcpy(grown, list->items, list->length * sizeof(void *));
+	}
+	freeItems(list);
+
+	list->items = grown;
+	list->capacity = newCapacity;
+	return true;
+}
+
+// Inserts data at index i of a vector list, moving the elements after it up.  Returns false if out of memory.
+static bool insertItem(List *list, int i, void *data)
+{
+	if (!reserveItem(list))
+	{
+		return false;
+	}
+
+	memmove(list->items + i + 1, list->items + i, (list->length - i) * sizeof(void *));
+	list->items[i] = data;
+	(list->length)++;
+	(list->changes)++;
+	return true;
+}
+
 /** Deletes the entire linked list, freeing all memory.
  * uses the supplied function pointer to release allocated memory for the data
  *@pre 'List' type must exist and be used in order to keep track of the linked list.
@@ -36,9 +155,16 @@ List *initializeList(char *(*printFunction)(void *toBePrinted), void (*deleteFun
  **/
 void freeList(List *list)
 {
+	if (list == NULL)
+	{
+		return;
+	}
 
 	clearList(list);
-	free(list);
+	if (list->arena == NULL)
+	{
+		poolFree(list, sizeof(List));
+	}
 }
 
 /** Clears the list: frees the contents of the list - Node structs and data stored in them -
@@ -56,11 +182,35 @@ void clearList(List *list)
 		return;
 	}
 
+	(list->changes)++;
+
+	if (list->storage == LIST_VECTOR)
+	{
+		for (int i = 0; i < list->length; i++)
+		{
+			list->deleteData(list->items[i]);
+		}
+		freeItems(list);
+		list->items = list->inlineItems;
+		list->capacity = LIST_INLINE_ITEMS;
+		list->length = 0;
+		return;
+	}
+
 	if (list->head == NULL && list->tail == NULL)
 	{
 		return;
 	}
 
+	// Arena lists do not own anything individually; the arena frees it all
+	if (list->arena != NULL)
+	{
+		list->head = NULL;
+		list->tail = NULL;
+		list->length = 0;
+		return;
+	}
+
 	Node *tmp;
 
 	while (list->head != NULL)
@@ -68,7 +218,7 @@ void clearList(List *list)
 		list->deleteData(list->head->data);
 		tmp = list->head;
 		list->head = list->head->next;
-		free(tmp);
+		poolFree(tmp, sizeof(Node));
 	}
 
 	list->head = NULL;
@@ -87,7 +237,8 @@ void clearList(List *list)
  **/
 Node *initializeNode(void *data)
 {
-	Node *tmpNode = (Node *)malloc(sizeof(Node));
+	// From the same pool as the nodes the list functions make, since those are the ones that free it
+	Node *tmpNode = (Node *)poolAlloc(sizeof(Node));
 
 	if (tmpNode == NULL)
 	{
@@ -107,16 +258,26 @@ Node *initializeNode(void *data)
  *@param list pointer to the dummy head of the list
  *@param toBeAdded a pointer to data that is to be added to the linked list
  **/
-void insertBack(List *list, void *toBeAdded)
+bool insertBack(List *list, void *toBeAdded)
 {
 	if (list == NULL || toBeAdded == NULL)
 	{
-		return;
+		return false;
 	}
 
-	(list->length)++;
+	if (list->storage == LIST_VECTOR)
+	{
+		return insertItem(list, list->length, toBeAdded);
+	}
 
-	Node *newNode = initializeNode(toBeAdded);
+	Node *newNode = newListNode(list, toBeAdded);
+	if (newNode == NULL)
+	{
+		return false;
+	}
+
+	(list->length)++;
+	(list->changes)++;
 
 	if (list->head == NULL && list->tail == NULL)
 	{
@@ -129,6 +290,7 @@ void insertBack(List *list, void *toBeAdded)
 		list->tail->next = newNode;
 		list->tail = newNode;
 	}
+	return true;
 }
 
 /**Inserts a Node at the front of a linked list.  List metadata is updated
@@ -137,16 +299,26 @@ void insertBack(List *list, void *toBeAdded)
  *@param list pointer to the dummy head of the list
  *@param toBeAdded a pointer to data that is to be added to the linked list
  **/
-void insertFront(List *list, void *toBeAdded)
+bool insertFront(List *list, void *toBeAdded)
 {
 	if (list == NULL || toBeAdded == NULL)
 	{
-		return;
+		return false;
 	}
 
-	(list->length)++;
+	if (list->storage == LIST_VECTOR)
+	{
+		return insertItem(list, 0, toBeAdded);
+	}
+
+	Node *newNode = newListNode(list, toBeAdded);
+	if (newNode == NULL)
+	{
+		return false;
+	}
 
-	Node *newNode = initializeNode(toBeAdded);
+	(list->length)++;
+	(list->changes)++;
 
 	if (list->head == NULL && list->tail == NULL)
 	{
@@ -159,6 +331,7 @@ void insertFront(List *list, void *toBeAdded)
 		list->head->previous = newNode;
 		list->head = newNode;
 	}
+	return true;
 }
 
 /**Returns a pointer to the data at the front of the list. Does not alter list structure.
@@ -168,6 +341,11 @@ void insertFront(List *list, void *toBeAdded)
  **/
 void *getFromFront(List *list)
 {
+	if (list->storage == LIST_VECTOR)
+	{
+		return list->length > 0 ? list->items[0] : NULL;
+	}
+
 	if (list->head == NULL)
 	{
 		return NULL;
@@ -183,6 +361,11 @@ void *getFromFront(List *list)
  **/
 void *getFromBack(List *list)
 {
+	if (list->storage == LIST_VECTOR)
+	{
+		return list->length > 0 ? list->items[list->length - 1] : NULL;
+	}
+
 	if (list->tail == NULL)
 	{
 		return NULL;
@@ -191,6 +374,21 @@ void *getFromBack(List *list)
 	return list->tail->data;
 }
 
+void *replaceFront(List *list, void *data)
+{
+	if (list == NULL || data == NULL || list->length == 0)
+	{
+		return NULL;
+	}
+
+	void **front = (list->storage == LIST_VECTOR) ? &list->items[0] : &list->head->data;
+	void *old = *front;
+	*front = data;
+	(list->changes)++;
+
+	return old;
+}
+
 void *deleteDataFromList(List *list, void *toBeDeleted)
 {
 	if (list == NULL || toBeDeleted == NULL)
@@ -198,6 +396,22 @@ void *deleteDataFromList(List *list, void *toBeDeleted)
 		return NULL;
 	}
 
+	if (list->storage == LIST_VECTOR)
+	{
+		for (int i = 0; i < list->length; i++)
+		{
+			if (list->compare(toBeDeleted, list->items[i]) == 0)
+			{
+				void *data = list->items[i];
+				memmove(list->items + i, list->items + i + 1, (list->length - i - 1) * sizeof(void *));
+				(list->length)--;
+				(list->changes)++;
+				return data;
+			}
+		}
+		return NULL;
+	}
+
 	Node *tmp = list->head;
 
 	while (tmp != NULL)
@@ -226,9 +440,13 @@ void *deleteDataFromList(List *list, void *toBeDeleted)
 			}
 
 			void *data = delNode->data;
-			free(delNode);
+			if (list->arena == NULL)
+			{
+				poolFree(delNode, sizeof(Node));
+			}
 
 			(list->length)--;
+			(list->changes)++;
 
 			return data;
 		}
@@ -250,29 +468,37 @@ void *deleteDataFromList(List *list, void *toBeDeleted)
 as a pointer to the first and last element of the list.
 *@param toBeAdded a pointer to data that is to be added to the linked list
 **/
-void insertSorted(List *list, void *toBeAdded)
+bool insertSorted(List *list, void *toBeAdded)
 {
 	if (list == NULL || toBeAdded == NULL)
 	{
-		return;
+		return false;
+	}
+
+	if (list->storage == LIST_VECTOR)
+	{
+		// Same position as the linked version: before the first element it does not sort after
+		int i = 0;
+		while (i < list->length && list->compare(toBeAdded, list->items[i]) > 0)
+		{
+			i++;
+		}
+		return insertItem(list, i, toBeAdded);
 	}
 
 	if (list->head == NULL)
 	{
-		insertBack(list, toBeAdded);
-		return;
+		return insertBack(list, toBeAdded);
 	}
 
 	if (list->compare(toBeAdded, list->head->data) <= 0)
 	{
-		insertFront(list, toBeAdded);
-		return;
+		return insertFront(list, toBeAdded);
 	}
 
 	if (list->compare(toBeAdded, list->tail->data) > 0)
 	{
-		insertBack(list, toBeAdded);
-		return;
+		return insertBack(list, toBeAdded);
 	}
 
 	Node *currNode = list->head;
@@ -290,20 +516,25 @@ void insertSorted(List *list, void *toBeAdded)
 			free(currDescr);
 			free(newDescr);
 
-			Node *newNode = initializeNode(toBeAdded);
+			Node *newNode = newListNode(list, toBeAdded);
+			if (newNode == NULL)
+			{
+				return false;
+			}
 			newNode->next = currNode;
 			newNode->previous = currNode->previous;
 			currNode->previous->next = newNode;
 			currNode->previous = newNode;
 			(list->length)++;
+			(list->changes)++;
 
-			return;
+			return true;
 		}
 
 		currNode = currNode->next;
 	}
 
-	return;
+	return true;
 }
 
 /**Returns a string that contains a string representation of the list traversed from  head to tail.
@@ -341,12 +572,25 @@ ListIterator createIterator(List *list)
 	ListIterator iter;
 
 	iter.current = list->head;
+	iter.item = NULL;
+	iter.end = NULL;
+
+	if (list->storage == LIST_VECTOR)
+	{
+		iter.item = list->items;
+		iter.end = list->items + list->length;
+	}
 
 	return iter;
 }
 
 void *nextElement(ListIterator *iter)
 {
+	if (iter->item != NULL)
+	{
+		return (iter->item < iter->end) ? *(iter->item++) : NULL;
+	}
+
 	Node *tmp = iter->current;
 
 	if (tmp != NULL)
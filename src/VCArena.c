@@ -0,0 +1,125 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCArena.h"
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_FIRST_BLOCK 4096
+#define ARENA_MAX_BLOCK (1 << 16)
+
+struct arenaBlock
+{
+    ArenaBlock *next;
+    alignas(max_align_t) char data[];
+};
+
+static size_t alignUp(size_t size)
+{
+    return (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+}
+
+Arena *createArena(void)
+{
+    Arena *arena = malloc(sizeof(Arena));
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+
+    arena->blocks = NULL;
+    arena->cursor = NULL;
+    arena->remaining = 0;
+    arena->nextBlockSize = ARENA_FIRST_BLOCK;
+
+    return arena;
+}
+
+void *arenaAlloc(Arena *arena, size_t size)
+{
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+
+    size = alignUp(size == 0 ? 1 : size);
+
+    if (size > arena->remaining)
+    {
+        // Oversized requests get a block of their own so the current block keeps its free space
+        size_t blockSize = arena->nextBlockSize;
+        bool dedicated = size > blockSize / 4;
+        if (dedicated)
+        {
+            blockSize = size;
+        }
+
+        ArenaBlock *block = malloc(sizeof(ArenaBlock) + blockSize);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+
+        if (dedicated && arena->blocks != NULL)
+        {
+            // Chain it behind the current block
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+            return block->data;
+        }
+
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->cursor = block->data;
+        arena->remaining = blockSize;
+
+        if (arena->nextBlockSize < ARENA_MAX_BLOCK)
+        {
+            arena->nextBlockSize *= 2;
+        }
+    }
+
+    void *result = arena->cursor;
+    arena->cursor += size;
+    arena->remaining -= size;
+
+    return result;
+}
+
+char *arenaStrndup(Arena *arena, const char *str, size_t n)
+{
+    size_t len = strnlen(str, n);
+    char *copy = arenaAlloc(arena, len + 1);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+
+    return copy;
+}
+
+char *arenaStrdup(Arena *arena, const char *str)
+{
+    return arenaStrndup(arena, str, strlen(str));
+}
+
+void destroyArena(Arena *arena)
+{
+    if (arena == NULL)
+    {
+        return;
+    }
+
+    ArenaBlock *block = arena->blocks;
+    while (block != NULL)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(arena);
+}
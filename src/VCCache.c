@@ -0,0 +1,432 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCCache.h"
+#include "VCIndex.h"
+#include "VCPool.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define CACHE_INITIAL_BUCKETS 64
+
+struct cachedCard {
+    // Key: the path as given, with the modification time and size the card was parsed at
+    char *path;
+    uint64_t hash;
+    struct timespec mtime;
+    off_t size;
+
+    Card *card;
+    size_t bytes;
+
+    // Callers holding this entry.  An entry is only freed once it is out of the cache and refs is 0.
+    int refs;
+    bool cached;
+
+    // Chain of the hash bucket
+    CachedCard *hashNext;
+
+    // Recency list, most recently used first
+    CachedCard *lruPrev;
+    CachedCard *lruNext;
+};
+
+// Everything below is guarded by cacheLock
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+static CachedCard **buckets = NULL;
+static size_t bucketCount = 0;
+static size_t entryCount = 0;
+static CachedCard *lruHead = NULL;
+static CachedCard *lruTail = NULL;
+static size_t usedBytes = 0;
+static size_t budget = CARD_CACHE_DEFAULT_BUDGET;
+
+// FNV-1a
+static uint64_t hashPath(const char *path)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *c = (const unsigned char *)path; *c != '\0'; c++)
+    {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Bytes of a list beyond the List struct itself
+static size_t listItemBytes(List *list)
+{
+    if (list->storage == LIST_VECTOR)
+    {
+        return (list->items == list->inlineItems) ? 0 : (size_t)list->capacity * sizeof(void *);
+    }
+    return (size_t)getLength(list) * sizeof(Node);
+}
+
+static size_t listBytes(List *list)
+{
+    return sizeof(List) + listItemBytes(list);
+}
+
+// Bytes of a list of a property, which may be part of the Property
+static size_t propertyListBytes(const Property *prop, List *list)
+{
+    bool embedded = (list == &prop->parameterList || list == &prop->valueList);
+    return embedded ? listItemBytes(list) : listBytes(list);
+}
+
+static size_t propertyBytes(const Property *prop)
+{
+    size_t bytes = sizeof(Property) + strlen(prop->name) + strlen(prop->group) + 2;
+
+    bytes += propertyListBytes(prop, prop->parameters);
+    ListIterator paramIter = createIterator(prop->parameters);
+    Parameter *param;
+    while ((param = nextElement(&paramIter)) != NULL)
+    {
+        bytes += sizeof(Parameter) + strlen(param->name) + strlen(param->value) + 2;
+    }
+
+    bytes += propertyListBytes(prop, prop->values);
+    ListIterator valueIter = createIterator(prop->values);
+    char *value;
+    while ((value = nextElement(&valueIter)) != NULL)
+    {
+        bytes += strlen(value) + 1;
+    }
+
+    return bytes;
+}
+
+static size_t dateBytes(const DateTime *dt)
+{
+    return dt ? sizeof(DateTime) + strlen(dt->date) + strlen(dt->time) + strlen(dt->text) + 3 : 0;
+}
+
+// Approximate heap footprint of a parsed card, ignoring allocator overhead
+static size_t cardBytes(const Card *card)
+{
+    size_t bytes = sizeof(Card) + propertyBytes(card->fn) + dateBytes(card->birthday) + dateBytes(card->anniversary);
+
+    bytes += listBytes(card->optionalProperties);
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
+    {
+        bytes += propertyBytes(prop);
+    }
+
+    return bytes;
+}
+
+static void freeEntry(CachedCard *entry)
+{
+    deleteCard(entry->card);
+    free(entry->path);
+    free(entry);
+}
+
+static CachedCard *findEntry(const char *path, uint64_t hash)
+{
+    if (bucketCount == 0)
+    {
+        return NULL;
+    }
+
+    for (CachedCard *entry = buckets[hash & (bucketCount - 1)]; entry != NULL; entry = entry->hashNext)
+    {
+        if (entry->hash == hash && strcmp(entry->path, path) == 0)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void lruUnlink(CachedCard *entry)
+{
+    if (entry->lruPrev != NULL)
+    {
+        entry->lruPrev->lruNext = entry->lruNext;
+    }
+    else
+    {
+        lruHead = entry->lruNext;
+    }
+
+    if (entry->lruNext != NULL)
+    {
+        entry->lruNext->lruPrev = entry->lruPrev;
+    }
+    else
+    {
+        lruTail = entry->lruPrev;
+    }
+
+    entry->lruPrev = NULL;
+    entry->lruNext = NULL;
+}
+
+static void lruPushFront(CachedCard *entry)
+{
+    entry->lruPrev = NULL;
+    entry->lruNext = lruHead;
+    if (lruHead != NULL)
+    {
+        lruHead->lruPrev = entry;
+    }
+    lruHead = entry;
+    if (lruTail == NULL)
+    {
+        lruTail = entry;
+    }
+}
+
+// Takes an entry out of the cache.  It is freed now, or by the last releaseCachedCard if it is in use.
+static void removeEntry(CachedCard *entry)
+{
+    CachedCard **link = &buckets[entry->hash & (bucketCount - 1)];
+    while (*link != entry)
+    {
+        link = &(*link)->hashNext;
+    }
+    *link = entry->hashNext;
+
+    lruUnlink(entry);
+    entryCount--;
+    usedBytes -= entry->bytes;
+    entry->cached = false;
+
+    if (entry->refs == 0)
+    {
+        freeEntry(entry);
+    }
+}
+
+// Doubles the bucket array once the load factor reaches 1.  Returns false if out of memory.
+static bool growBuckets(void)
+{
+    if (entryCount < bucketCount)
+    {
+        return true;
+    }
+
+    size_t newCount = bucketCount ? bucketCount * 2 : CACHE_INITIAL_BUCKETS;
+    CachedCard **grown = calloc(newCount, sizeof(CachedCard *));
+    if (grown == NULL)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < bucketCount; i++)
+    {
+        CachedCard *entry = buckets[i];
+        while (entry != NULL)
+        {
+            CachedCard *next = entry->hashNext;
+            entry->hashNext = grown[entry->hash & (newCount - 1)];
+            grown[entry->hash & (newCount - 1)] = entry;
+            entry = next;
+        }
+    }
+
+    free(buckets);
+    buckets = grown;
+    bucketCount = newCount;
+    return true;
+}
+
+// Evicts least recently used entries that are not in use until the cache fits its budget
+static void evict(void)
+{
+    CachedCard *entry = lruTail;
+    while (usedBytes > budget && entry != NULL)
+    {
+        CachedCard *prev = entry->lruPrev;
+        if (entry->refs == 0)
+        {
+            removeEntry(entry);
+        }
+        entry = prev;
+    }
+}
+
+static bool sameVersion(const CachedCard *entry, const struct stat *st)
+{
+    return entry->size == st->st_size && entry->mtime.tv_sec == st->st_mtim.tv_sec && entry->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+VCardErrorCode getCachedCard(const char *fileName, CachedCard **entry)
+{
+    if (fileName == NULL || entry == NULL)
+    {
+        return INV_FILE;
+    }
+
+    *entry = NULL;
+
+    struct stat st;
+    if (stat(fileName, &st) != 0)
+    {
+        return INV_FILE;
+    }
+
+    uint64_t hash = hashPath(fileName);
+
+    pthread_mutex_lock(&cacheLock);
+    CachedCard *found = findEntry(fileName, hash);
+    if (found != NULL && sameVersion(found, &st))
+    {
+        found->refs++;
+        lruUnlink(found);
+        lruPushFront(found);
+        pthread_mutex_unlock(&cacheLock);
+
+        *entry = found;
+        return OK;
+    }
+    if (found != NULL)
+    {
+        removeEntry(found);
+    }
+    pthread_mutex_unlock(&cacheLock);
+
+    // Parse without holding the lock, so other files can be looked up meanwhile
+    CachedCard *newEntry = calloc(1, sizeof(CachedCard));
+    if (newEntry == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    newEntry->path = strdup(fileName);
+    if (newEntry->path == NULL)
+    {
+        free(newEntry);
+        return OTHER_ERROR;
+    }
+
+    VCardErrorCode err = createCard(newEntry->path, &newEntry->card);
+    if (err != OK)
+    {
+        freeEntry(newEntry);
+        return err;
+    }
+
+    // Cached cards are shared between threads, so their index is built before anyone can look things up
+    buildPropertyIndex(newEntry->card);
+
+    newEntry->hash = hash;
+    newEntry->mtime = st.st_mtim;
+    newEntry->size = st.st_size;
+    newEntry->bytes = cardBytes(newEntry->card);
+    newEntry->refs = 1;
+
+    pthread_mutex_lock(&cacheLock);
+
+    // Another thread may have parsed the same version in the meantime
+    found = findEntry(fileName, hash);
+    if (found != NULL && sameVersion(found, &st))
+    {
+        found->refs++;
+        lruUnlink(found);
+        lruPushFront(found);
+        pthread_mutex_unlock(&cacheLock);
+
+        freeEntry(newEntry);
+        *entry = found;
+        return OK;
+    }
+    if (found != NULL)
+    {
+        removeEntry(found);
+    }
+
+    // Cards bigger than the whole budget are handed out without being cached
+    if (newEntry->bytes <= budget && growBuckets())
+    {
+        CachedCard **bucket = &buckets[hash & (bucketCount - 1)];
+        newEntry->hashNext = *bucket;
+        *bucket = newEntry;
+        lruPushFront(newEntry);
+        entryCount++;
+        usedBytes += newEntry->bytes;
+        newEntry->cached = true;
+        evict();
+    }
+    pthread_mutex_unlock(&cacheLock);
+
+    *entry = newEntry;
+    return OK;
+}
+
+const Card *cachedCardData(const CachedCard *entry)
+{
+    return entry->card;
+}
+
+void releaseCachedCard(CachedCard *entry)
+{
+    if (entry == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&cacheLock);
+    entry->refs--;
+    bool unused = (entry->refs == 0 && !entry->cached);
+    if (entry->refs == 0 && entry->cached)
+    {
+        // It may have been kept over budget only because it was in use
+        evict();
+    }
+    pthread_mutex_unlock(&cacheLock);
+
+    if (unused)
+    {
+        freeEntry(entry);
+    }
+}
+
+void invalidateCachedCard(const char *fileName)
+{
+    if (fileName == NULL)
+    {
+        return;
+    }
+
+    uint64_t hash = hashPath(fileName);
+
+    pthread_mutex_lock(&cacheLock);
+    CachedCard *found = findEntry(fileName, hash);
+    if (found != NULL)
+    {
+        removeEntry(found);
+    }
+    pthread_mutex_unlock(&cacheLock);
+}
+
+void setCardCacheBudget(size_t bytes)
+{
+    pthread_mutex_lock(&cacheLock);
+    budget = bytes;
+    evict();
+    pthread_mutex_unlock(&cacheLock);
+}
+
+void clearCardCache(void)
+{
+    pthread_mutex_lock(&cacheLock);
+    CachedCard *entry = lruHead;
+    while (entry != NULL)
+    {
+        CachedCard *next = entry->lruNext;
+        if (entry->refs == 0)
+        {
+            removeEntry(entry);
+        }
+        entry = next;
+    }
+    pthread_mutex_unlock(&cacheLock);
+
+    poolTrim();
+}
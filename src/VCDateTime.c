@@ -0,0 +1,302 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCParser.h"
+#include "VCHelpers.h"
+
+// Position and width of each field of a key, in DateKeyField order
+static const int keyShift[DATE_KEY_FIELDS] = {50, 46, 40, 35, 29, 23};
+static const int keyWidth[DATE_KEY_FIELDS] = {14, 4, 6, 5, 6, 6};
+
+#define KEY_UTC_BIT (1ULL << 22)
+#define KEY_OFFSET_SHIFT 10
+#define KEY_OFFSET_MASK 0xFFFULL
+// Offsets are stored as minutes + KEY_OFFSET_BIAS, so that 0 means none
+#define KEY_OFFSET_BIAS 1440
+
+// Fields of a date-and-or-time value; -1 marks an unspecified field
+typedef struct dateFields
+{
+    int field[DATE_KEY_FIELDS];
+    bool hasOffset;
+    int offset;
+} DateFields;
+
+// Reads n digits at s.  Returns -1 if they are not all digits.
+static int readNumber(const char *s, int n)
+{
+    int value = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (s[i] < '0' || s[i] > '9')
+        {
+            return -1;
+        }
+        value = value * 10 + (s[i] - '0');
+    }
+    return value;
+}
+
+// Reads a field of n digits at s and checks its range.  Returns false if it is not valid.
+static bool readField(DateFields *fields, DateKeyField field, const char *s, int n, int min, int max)
+{
+    int value = readNumber(s, n);
+    if (value < min || value > max)
+    {
+        return false;
+    }
+    fields->field[field] = value;
+    return true;
+}
+
+// Counts the characters c at s[pos], up to max
+static size_t countChars(const char *s, size_t len, size_t pos, char c, size_t max)
+{
+    size_t n = 0;
+    while (n < max && pos + n < len && s[pos + n] == c)
+    {
+        n++;
+    }
+    return n;
+}
+
+static size_t countDigits(const char *s, size_t len, size_t pos)
+{
+    size_t n = 0;
+    while (pos + n < len && s[pos + n] >= '0' && s[pos + n] <= '9')
+    {
+        n++;
+    }
+    return n;
+}
+
+/*	Reads a date at s[*pos] and moves *pos past it: YYYYMMDD, YYYY-MM, YYYY, --MMDD, --MM or ---DD.
+	The leading dashes and the number of digits after them decide the form, so every character is read once.
+*/
+static bool scanDate(const char *s, size_t len, size_t *pos, DateFields *fields)
+{
+    size_t dashes = countChars(s, len, *pos, '-', 3);
+    const char *digits = s + *pos + dashes;
+    size_t count = countDigits(s, len, *pos + dashes);
+    *pos += dashes + count;
+
+    switch (dashes)
+    {
+    case 0:
+        if (count == 8)
+        {
+            return readField(fields, DATE_KEY_YEAR, digits, 4, 0, 9999) && readField(fields, DATE_KEY_MONTH, digits + 4, 2, 1, 12) &&
+                   readField(fields, DATE_KEY_DAY, digits + 6, 2, 1, 31);
+        }
+        if (count != 4 || !readField(fields, DATE_KEY_YEAR, digits, 4, 0, 9999))
+        {
+            return false;
+        }
+
+        // YYYY-MM
+        if (*pos < len && s[*pos] == '-')
+        {
+            if (countDigits(s, len, *pos + 1) != 2)
+            {
+                return false;
+            }
+            *pos += 3;
+            return readField(fields, DATE_KEY_MONTH, digits + 5, 2, 1, 12);
+        }
+        return true;
+    case 2:
+        return (count == 2 || count == 4) && readField(fields, DATE_KEY_MONTH, digits, 2, 1, 12) &&
+               (count == 2 || readField(fields, DATE_KEY_DAY, digits + 2, 2, 1, 31));
+    case 3:
+        return count == 2 && readField(fields, DATE_KEY_DAY, digits, 2, 1, 31);
+    default:
+        return false;
+    }
+}
+
+/*	Reads a time at s[*pos] and moves *pos past it: HHMMSS, HHMM, HH, -MMSS, -MM or --SS, followed by an
+	optional Z (which sets *utc) or +hh, +hhmm, -hh or -hhmm offset.
+*/
+static bool scanTime(const char *s, size_t len, size_t *pos, DateFields *fields, bool *utc)
+{
+    // Leading dashes stand for the hour, or the hour and minute
+    size_t dashes = countChars(s, len, *pos, '-', 2);
+    const char *digits = s + *pos + dashes;
+    size_t count = countDigits(s, len, *pos + dashes);
+    *pos += dashes + count;
+
+    static const int limits[] = {23, 59, 60};
+    size_t pairs = count / 2;
+    if (count % 2 != 0 || pairs == 0 || dashes + pairs > 3)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < pairs; i++)
+    {
+        size_t part = dashes + i;
+        if (!readField(fields, DATE_KEY_HOUR + part, digits + 2 * i, 2, 0, limits[part]))
+        {
+            return false;
+        }
+    }
+
+    if (*pos == len)
+    {
+        return true;
+    }
+
+    if (s[*pos] == 'Z')
+    {
+        *utc = true;
+        (*pos)++;
+        return true;
+    }
+
+    if (s[*pos] != '+' && s[*pos] != '-')
+    {
+        return false;
+    }
+
+    const char *zone = s + *pos;
+    size_t zoneDigits = countDigits(s, len, *pos + 1);
+    if (zoneDigits != 2 && zoneDigits != 4)
+    {
+        return false;
+    }
+    *pos += 1 + zoneDigits;
+
+    int hours = readNumber(zone + 1, 2);
+    int minutes = (zoneDigits == 4) ? readNumber(zone + 3, 2) : 0;
+    if (hours > 23 || minutes > 59)
+    {
+        return false;
+    }
+
+    fields->hasOffset = true;
+    fields->offset = (zone[0] == '-' ? -1 : 1) * (hours * 60 + minutes);
+    return true;
+}
+
+static uint64_t packFields(const DateFields *fields, bool utc)
+{
+    uint64_t key = 0;
+    for (int f = 0; f < DATE_KEY_FIELDS; f++)
+    {
+        if (fields->field[f] >= 0)
+        {
+            key |= (uint64_t)(fields->field[f] + 1) << keyShift[f];
+        }
+    }
+
+    // Only a date or time with at least one field has a key
+    if (key == 0)
+    {
+        return 0;
+    }
+
+    if (utc)
+    {
+        key |= KEY_UTC_BIT;
+    }
+    if (fields->hasOffset)
+    {
+        key |= (uint64_t)(fields->offset + KEY_OFFSET_BIAS) << KEY_OFFSET_SHIFT;
+    }
+    return key;
+}
+
+uint64_t dateTimeKey(const DateTime *dt)
+{
+    if (dt == NULL || dt->isText || dt->date == NULL || dt->time == NULL)
+    {
+        return 0;
+    }
+
+    DateFields fields = {{-1, -1, -1, -1, -1, -1}, false, 0};
+    bool utc = dt->UTC;
+
+    size_t dateLen = strlen(dt->date);
+    size_t pos = 0;
+    if (dateLen > 0 && (!scanDate(dt->date, dateLen, &pos, &fields) || pos != dateLen))
+    {
+        return 0;
+    }
+
+    size_t timeLen = strlen(dt->time);
+    pos = 0;
+    if (timeLen > 0 && (!scanTime(dt->time, timeLen, &pos, &fields, &utc) || pos != timeLen))
+    {
+        return 0;
+    }
+
+    return packFields(&fields, utc);
+}
+
+VCardErrorCode parseDateValue(const char *value, size_t length, DateValue *result)
+{
+    DateFields fields = {{-1, -1, -1, -1, -1, -1}, false, 0};
+    size_t pos = 0;
+
+    result->UTC = false;
+
+    // [date]
+    if (pos < length && value[pos] != 'T' && !scanDate(value, length, &pos, &fields))
+    {
+        return INV_DT;
+    }
+    result->dateLength = pos;
+
+    // ["T" time [zone]]; the stored time keeps an offset but not a Z
+    result->timeStart = pos;
+    result->timeLength = 0;
+    if (pos < length)
+    {
+        if (value[pos] != 'T')
+        {
+            return INV_DT;
+        }
+        result->timeStart = ++pos;
+
+        if (!scanTime(value, length, &pos, &fields, &result->UTC))
+        {
+            return INV_DT;
+        }
+        result->timeLength = pos - result->timeStart - (result->UTC ? 1 : 0);
+    }
+
+    if (pos != length || (result->dateLength == 0 && result->timeLength == 0))
+    {
+        return INV_DT;
+    }
+
+    result->key = packFields(&fields, result->UTC);
+    return OK;
+}
+
+int compareDateKeys(uint64_t first, uint64_t second)
+{
+    return (first > second) - (first < second);
+}
+
+int dateKeyField(uint64_t key, DateKeyField field)
+{
+    if (field < 0 || field >= DATE_KEY_FIELDS)
+    {
+        return -1;
+    }
+
+    int stored = (int)((key >> keyShift[field]) & ((1ULL << keyWidth[field]) - 1));
+    return stored - 1;
+}
+
+int dateKeyOffset(uint64_t key, bool *specified)
+{
+    if (key & KEY_UTC_BIT)
+    {
+        *specified = true;
+        return 0;
+    }
+
+    int stored = (int)((key >> KEY_OFFSET_SHIFT) & KEY_OFFSET_MASK);
+    *specified = (stored != 0);
+    return stored ? stored - KEY_OFFSET_BIAS : 0;
+}
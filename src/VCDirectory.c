@@ -0,0 +1,222 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCDirectory.h"
+#include "VCHelpers.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+// Shared state of one parseDirectory call
+typedef struct directoryJob
+{
+    ParseResult *results;
+    size_t count;
+
+    // Index of the next file to hand out
+    atomic_size_t next;
+
+    // Check each file with validateFile instead of building its card
+    bool validateOnly;
+
+    void (*callback)(ParseResult *result, void *context);
+    void *context;
+    pthread_mutex_t callbackLock;
+} DirectoryJob;
+
+static int compareResultPaths(const void *first, const void *second)
+{
+    return strcmp(((const ParseResult *)first)->path, ((const ParseResult *)second)->path);
+}
+
+// Collects the paths of all card files in the directory
+static VCardErrorCode listCardFiles(const char *dirName, ParseResult **results, size_t *count)
+{
+    DIR *dir = opendir(dirName);
+    if (dir == NULL)
+    {
+        return INV_FILE;
+    }
+
+    ParseResult *list = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    size_t dirLen = strlen(dirName);
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!hasCardExtension(entry->d_name))
+        {
+            continue;
+        }
+
+        if (length == capacity)
+        {
+            size_t newCapacity = capacity ? capacity * 2 : 64;
+            ParseResult *grown = realloc(list, newCapacity * sizeof(ParseResult));
+            if (grown == NULL)
+            {
+                closedir(dir);
+                freeParseResults(list, length);
+                return OTHER_ERROR;
+            }
+            list = grown;
+            capacity = newCapacity;
+        }
+
+        char *path = malloc(dirLen + strlen(entry->d_name) + 2);
+        if (path == NULL)
+        {
+            closedir(dir);
+            freeParseResults(list, length);
+            return OTHER_ERROR;
+        }
+        sprintf(path, "%s/%s", dirName, entry->d_name);
+
+        list[length].path = path;
+        list[length].error = OK;
+        list[length].card = NULL;
+        length++;
+    }
+
+    closedir(dir);
+
+    if (length > 1)
+    {
+        qsort(list, length, sizeof(ParseResult), compareResultPaths);
+    }
+
+    *results = list;
+    *count = length;
+    return OK;
+}
+
+static void parseOne(DirectoryJob *job, ParseResult *result)
+{
+    if (job->validateOnly)
+    {
+        result->error = validateFile(result->path);
+    }
+    else
+    {
+        result->error = createCard(result->path, &result->card);
+        if (result->error == OK)
+        {
+            result->error = validateCard(result->card);
+        }
+    }
+
+    if (job->callback != NULL)
+    {
+        pthread_mutex_lock(&job->callbackLock);
+        job->callback(result, job->context);
+        pthread_mutex_unlock(&job->callbackLock);
+    }
+}
+
+static void *directoryWorker(void *arg)
+{
+    DirectoryJob *job = arg;
+
+    size_t i;
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->count)
+    {
+        parseOne(job, &job->results[i]);
+    }
+
+    return NULL;
+}
+
+// Runs parseOne on every card file of the directory, for parseDirectory and validateDirectory
+static VCardErrorCode processDirectory(const char *dirName, int nthreads, bool validateOnly,
+                                       void (*callback)(ParseResult *result, void *context), void *context,
+                                       ParseResult **results, size_t *count)
+{
+    if (dirName == NULL || results == NULL || count == NULL)
+    {
+        return INV_FILE;
+    }
+
+    *results = NULL;
+    *count = 0;
+
+    DirectoryJob job;
+    VCardErrorCode err = listCardFiles(dirName, &job.results, &job.count);
+    if (err != OK)
+    {
+        return err;
+    }
+
+    atomic_init(&job.next, 0);
+    job.validateOnly = validateOnly;
+    job.callback = callback;
+    job.context = context;
+    pthread_mutex_init(&job.callbackLock, NULL);
+
+    if (nthreads <= 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 0 ? (int)cpus : 1;
+    }
+    if ((size_t)nthreads > job.count)
+    {
+        nthreads = (int)job.count;
+    }
+
+    // The calling thread is one of the workers.  If threads can not be started, it does all the work.
+    pthread_t *threads = NULL;
+    int started = 0;
+    if (nthreads > 1)
+    {
+        threads = malloc((size_t)(nthreads - 1) * sizeof(pthread_t));
+        for (int t = 0; threads != NULL && t < nthreads - 1; t++)
+        {
+            if (pthread_create(&threads[t], NULL, directoryWorker, &job) != 0)
+            {
+                break;
+            }
+            started++;
+        }
+    }
+
+    directoryWorker(&job);
+
+    for (int t = 0; t < started; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    free(threads);
+    pthread_mutex_destroy(&job.callbackLock);
+
+    *results = job.results;
+    *count = job.count;
+    return OK;
+}
+
+VCardErrorCode parseDirectory(const char *dirName, int nthreads,
+                              void (*callback)(ParseResult *result, void *context), void *context,
+                              ParseResult **results, size_t *count)
+{
+    return processDirectory(dirName, nthreads, false, callback, context, results, count);
+}
+
+VCardErrorCode validateDirectory(const char *dirName, int nthreads, ParseResult **results, size_t *count)
+{
+    return processDirectory(dirName, nthreads, true, NULL, NULL, results, count);
+}
+
+void freeParseResults(ParseResult *results, size_t count)
+{
+    if (results == NULL)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        free(results[i].path);
+        deleteCard(results[i].card);
+    }
+
+    free(results);
+}
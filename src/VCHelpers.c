@@ -2,19 +2,132 @@
 // 1269872
 #define _POSIX_C_SOURCE 200809L
 #include "VCParser.h"
+#include "VCHelpers.h"
+#include "VCArena.h"
+#include "VCScan.h"
+#include "VCPool.h"
 #include "LinkedListAPI.h"
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-bool parameterExists(List *parameters, const char *name, const char *value)
+// Parts of an arena card come from its arena, parts of any other card from the heap
+void *cardAlloc(Card *card, size_t size)
+{
+    return card->arena != NULL ? arenaAlloc(card->arena, size) : malloc(size);
+}
+
+char *cardStrndup(Card *card, const char *str, size_t n)
+{
+    return card->arena != NULL ? arenaStrndup(card->arena, str, n) : strndup(str, n);
+}
+
+char *cardStrdup(Card *card, const char *str)
+{
+    return cardStrndup(card, str, strlen(str));
+}
+
+List *cardList(Card *card, char *(*printFunction)(void *toBePrinted), void (*deleteFunction)(void *toBeDeleted), int (*compareFunction)(const void *first, const void *second))
+{
+    if (card->arena != NULL)
+    {
+        return initializeListInArena(card->arena, printFunction, deleteFunction, compareFunction);
+    }
+    // Card lists are appended to while parsing and then only iterated, which is what vector lists are best at,
+    // but code written for linked lists may walk them by their nodes unless the caller opted in
+    return initializeListWithStorage(card->compactLists ? LIST_VECTOR : LIST_LINKED, printFunction, deleteFunction, compareFunction);
+}
+
+// Frees a property that was never attached to the card
+static void discardProperty(Card *card, Property *prop)
+{
+    if (card->arena == NULL)
+    {
+        deleteProperty(prop);
+    }
+}
+
+static void discardDate(Card *card, DateTime *dt)
+{
+    if (card->arena == NULL)
+    {
+        deleteDate(dt);
+    }
+}
+
+_Static_assert(sizeof(Property) <= POOL_MAX_OBJECT, "parsed properties are allocated from the pool");
+
+// Takes ownership of group and name, which must come from cardStrdup.  Returns NULL if anything is NULL.
+static Property *newCardProperty(Card *card, char *group, char *name, PropertyId id)
+{
+    // Compact properties come from the pool; deleteProperty tells them apart by their embedded lists
+    bool compact = (card->arena == NULL && card->compactLists);
+    Property *prop;
+    if (card->arena != NULL)
+    {
+        prop = arenaAlloc(card->arena, sizeof(Property));
+    }
+    else
+    {
+        prop = compact ? poolAlloc(sizeof(Property)) : malloc(sizeof(Property));
+    }
+
+    if (prop == NULL || group == NULL || name == NULL)
+    {
+        if (card->arena == NULL)
+        {
+            if (compact)
+            {
+                poolFree(prop, sizeof(Property));
+            }
+            else
+            {
+                free(prop);
+            }
+            free(group);
+            free(name);
+        }
+        return NULL;
+    }
+
+    prop->name = name;
+    prop->group = group;
+    prop->id = id;
+    prop->raw = NULL;
+    prop->hash = 0;
+    prop->made = LIBRARY_MADE;
+
+    if (compact)
+    {
+        initializeListInPlace(&prop->parameterList, LIST_VECTOR, parameterToString, deleteParameter, compareParameters);
+        initializeListInPlace(&prop->valueList, LIST_VECTOR, valueToString, deleteValue, compareValues);
+        prop->parameters = &prop->parameterList;
+        prop->values = &prop->valueList;
+        return prop;
+    }
+
+    prop->parameters = cardList(card, parameterToString, deleteParameter, compareParameters);
+    prop->values = cardList(card, valueToString, deleteValue, compareValues);
+
+    if (prop->parameters == NULL || prop->values == NULL)
+    {
+        discardProperty(card, prop);
+        return NULL;
+    }
+
+    return prop;
+}
+
+// Same as parameterExists, for a name and value that are not NUL-terminated
+static bool parameterExistsN(List *parameters, const char *name, size_t nameLen, const char *value, size_t valueLen)
 {
     ListIterator iter = createIterator(parameters);
     Parameter *param;
     while ((param = nextElement(&iter)) != NULL)
     {
-        if (strcmp(param->name, name) == 0 && strcmp(param->value, value) == 0)
+        if (strncmp(param->name, name, nameLen) == 0 && param->name[nameLen] == '\0' &&
+            strncmp(param->value, value, valueLen) == 0 && param->value[valueLen] == '\0')
         {
             return true;
         }
@@ -22,327 +135,661 @@ bool parameterExists(List *parameters, const char *name, const char *value)
     return false;
 }
 
-void addParameter(Property *prop, const char *name, const char *value)
+// Same as addParameter, for a name and value that are not NUL-terminated.  Returns false if out of memory.
+static bool addParameterN(Property *prop, const char *name, size_t nameLen, const char *value, size_t valueLen)
 {
-    if (!parameterExists(prop->parameters, name, value))
+    if (parameterExistsN(prop->parameters, name, nameLen, value, valueLen))
     {
-        Parameter *param = malloc(sizeof(Parameter));
-        if (param == NULL)
-        {
-            return;
-        }
-        param->name = strdup(name);
-        param->value = strdup(value);
-        insertBack(prop->parameters, param);
+        return true;
     }
-}
 
-VCardErrorCode createCardHelper(const char *line, Card *newCard, bool *fnFound)
-{
-    if (strncmp(line, "FN:", 3) == 0 && !(*fnFound))
+    // Parameters of an arena card share the arena of their list
+    Arena *arena = prop->parameters->arena;
+    Parameter *param = arena ? arenaAlloc(arena, sizeof(Parameter)) : malloc(sizeof(Parameter));
+    if (param == NULL)
     {
-        *fnFound = true;
+        return false;
+    }
 
-        char *fnValue = strdup(line + 3);
-        if (fnValue == NULL)
+    param->name = arena ? arenaStrndup(arena, name, nameLen) : strndup(name, nameLen);
+    param->value = arena ? arenaStrndup(arena, value, valueLen) : strndup(value, valueLen);
+    if (param->name == NULL || param->value == NULL)
+    {
+        if (arena == NULL)
         {
-            return OTHER_ERROR;
+            deleteParameter(param);
         }
+        return false;
+    }
+    param->hash = hashParameter(param);
 
-        Property *fnProperty = malloc(sizeof(Property));
-        if (fnProperty == NULL)
+    if (!insertBack(prop->parameters, param))
+    {
+        if (arena == NULL)
         {
-            free(fnValue);
-            return OTHER_ERROR;
+            deleteParameter(param);
         }
+        return false;
+    }
+    return true;
+}
 
-        fnProperty->name = strdup("FN");
-        if (fnProperty->name == NULL)
-        {
-            free(fnValue);
-            free(fnProperty);
-            return OTHER_ERROR;
-        }
+bool parameterExists(List *parameters, const char *name, const char *value)
+{
+    return parameterExistsN(parameters, name, strlen(name), value, strlen(value));
+}
 
-        fnProperty->group = strdup("");
-        if (fnProperty->group == NULL)
-        {
-            free(fnProperty->name);
-            free(fnValue);
-            free(fnProperty);
-            return OTHER_ERROR;
-        }
+void addParameter(Property *prop, const char *name, const char *value)
+{
+    addParameterN(prop, name, strlen(name), value, strlen(value));
 
-        fnProperty->parameters = initializeList(parameterToString, deleteParameter, compareParameters);
-        if (fnProperty->parameters == NULL)
-        {
-            free(fnProperty->group);
-            free(fnProperty->name);
-            free(fnValue);
-            free(fnProperty);
-            return OTHER_ERROR;
-        }
+    // Keep a known hash in step; properties being parsed get theirs once they are complete
+    if (prop->hash != 0)
+    {
+        prop->hash = hashProperty(prop);
+    }
+}
 
-        fnProperty->values = initializeList(valueToString, deleteValue, compareValues);
-        if (fnProperty->values == NULL)
+Card *newEmptyCard(const CardParseOptions *options)
+{
+    Arena *arena = NULL;
+    if (options != NULL && options->useArena)
+    {
+        arena = createArena();
+        if (arena == NULL)
         {
-            freeList(fnProperty->parameters);
-            free(fnProperty->group);
-            free(fnProperty->name);
-            free(fnValue);
-            free(fnProperty);
-            return OTHER_ERROR;
+            return NULL;
         }
+    }
 
-        insertBack(fnProperty->values, fnValue);
-        newCard->fn = fnProperty;
+    Card *newCard = arena ? arenaAlloc(arena, sizeof(Card)) : malloc(sizeof(Card));
+    if (newCard == NULL)
+    {
+        destroyArena(arena);
+        return NULL;
     }
-    else if (strstr(line, "BDAY") == line || strstr(line, "ANNIVERSARY") == line)
+
+    newCard->fn = NULL;
+    newCard->birthday = NULL;
+    newCard->anniversary = NULL;
+    newCard->arena = arena;
+    newCard->index = NULL;
+    newCard->compactLists = (options != NULL && options->compactLists);
+    newCard->made = LIBRARY_MADE;
+    newCard->optionalProperties = cardList(newCard, propertyToString, deleteProperty, compareProperties);
+
+    if (newCard->optionalProperties == NULL)
     {
-        DateTime *dt = malloc(sizeof(DateTime));
-        if (dt == NULL)
-        {
-            return OTHER_ERROR;
-        }
+        deleteCard(newCard);
+        return NULL;
+    }
 
-        dt->UTC = false;
-        dt->isText = false;
-        dt->date = NULL;
-        dt->time = strdup("");
-        dt->text = strdup("");
+    return newCard;
+}
 
-        // Find the colon to separate parameters from value
-        char *colon = strchr(line, ':');
-        if (colon == NULL || colon == line)
+// Checks the parameters of a BDAY or ANNIVERSARY line for VALUE=text
+static bool dateIsText(const char *line, const PropertySplit *split)
+{
+    const char *colon = line + split->colon;
+    for (const char *p = line; p + 10 <= colon; p++)
+    {
+        if (strncmp(p, "VALUE=text", 10) == 0)
         {
-            free(dt->time);
-            free(dt->text);
-            free(dt);
-            return INV_CARD;
+            return true;
         }
+    }
+    return false;
+}
+
+VCardErrorCode checkDateLine(const char *line, size_t length, const PropertySplit *split)
+{
+    if (dateIsText(line, split))
+    {
+        return OK;
+    }
 
-        // Extract parameters and check for VALUE=text
-        char *paramsAndName = strndup(line, colon - line);
-        bool isTextDate = (strstr(paramsAndName, "VALUE=text") != NULL);
-        free(paramsAndName);
+    DateValue parsed;
+    return parseDateValue(line + split->colon + 1, length - split->colon - 1, &parsed);
+}
 
-        char *value = strdup(colon + 1);
-        if (value == NULL)
-        {
-            free(dt->time);
-            free(dt->text);
-            free(dt);
-            return OTHER_ERROR;
-        }
+VCardErrorCode validateDateLine(const char *line, const PropertySplit *split)
+{
+    // A text date needs some text; checkDateLine has already rejected empty date-and-or-time values
+    if (dateIsText(line, split))
+    {
+        return line[split->colon + 1] != '\0' ? OK : INV_DT;
+    }
+    return OK;
+}
+
+// Parses the value of a BDAY or ANNIVERSARY line.  Returns INV_DT if a date-and-or-time value is malformed.
+static VCardErrorCode createDateTime(const char *line, const PropertySplit *split, Card *newCard, DateTime **result)
+{
+    const char *value = line + split->colon + 1;
+    size_t valueLen = strlen(value);
+
+    DateValue parsed = {0};
+    bool isText = dateIsText(line, split);
+    if (!isText && parseDateValue(value, valueLen, &parsed) != OK)
+    {
+        return INV_DT;
+    }
 
-        dt->isText = isTextDate; // Set flag based on parameters
+    DateTime *dt = cardAlloc(newCard, sizeof(DateTime));
+    if (dt == NULL)
+    {
+        return OTHER_ERROR;
+    }
 
-        if (dt->isText)
+    dt->UTC = parsed.UTC;
+    dt->isText = isText;
+    dt->raw = NULL;
+    dt->key = parsed.key;
+    dt->made = LIBRARY_MADE;
+
+    if (isText)
+    {
+        dt->text = cardStrndup(newCard, value, valueLen);
+        dt->date = cardStrdup(newCard, "");
+        dt->time = cardStrdup(newCard, "");
+    }
+    else
+    {
+        dt->date = cardStrndup(newCard, value, parsed.dateLength);
+        dt->time = cardStrndup(newCard, value + parsed.timeStart, parsed.timeLength);
+        dt->text = cardStrdup(newCard, "");
+    }
+
+    if (dt->date == NULL || dt->time == NULL || dt->text == NULL)
+    {
+        discardDate(newCard, dt);
+        return OTHER_ERROR;
+    }
+
+    *result = dt;
+    return OK;
+}
+
+static VCardErrorCode addParameterToken(void *context, const char *name, size_t nameLen, const char *value, size_t valueLen)
+{
+    return addParameterN((Property *)context, name, nameLen, value, valueLen) ? OK : OTHER_ERROR;
+}
+
+typedef struct valueTarget
+{
+    Card *card;
+    Property *prop;
+} ValueTarget;
+
+static VCardErrorCode addValueToken(void *context, const char *value, size_t valueLen)
+{
+    ValueTarget *target = context;
+
+    char *token = cardStrndup(target->card, value, valueLen);
+    if (token == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    if (!insertBack(target->prop->values, token))
+    {
+        if (target->card->arena == NULL)
         {
-            free(dt->text);
-            dt->text = strdup(value);
-            dt->date = strdup("");
+            free(token);
         }
-        else
-        {
-            // Check if it ends with 'Z' (UTC time)
-            size_t len = strlen(value);
-            if (len > 0 && value[len - 1] == 'Z')
-            {
-                dt->UTC = true;
-                value[len - 1] = '\0';
-            }
+        return OTHER_ERROR;
+    }
+    return OK;
+}
 
-            if (strncmp(value, "--", 2) == 0)
-            {
-                free(dt->time);
-                dt->date = strdup(value); // Store `--0203` as-is
-                dt->time = strdup("");    // No time
-            }
-            else
-            {
-                // Split full DateTime into date and time
-                char *T = strchr(value, 'T');
-                if (T != NULL)
-                {
-                    free(dt->time);
-                    *T = '\0'; // Split date and time
-                    dt->date = strdup(value);
-                    dt->time = strdup(T + 1);
-                }
-                else
-                {
-                    free(dt->time);
-                    dt->date = strdup(value);
-                    dt->time = strdup("");
-                }
-            }
-        }
+// Builds a property from "[group.]name[;parameters]:value" using the structural index of the line
+static VCardErrorCode createProperty(const char *line, size_t length, const StructuralIndex *index, const PropertySplit *split, PropertyId id, const char *raw, Card *newCard)
+{
+    VCardErrorCode err;
+    Property *newProperty = newCardProperty(newCard,
+                                            cardStrndup(newCard, line, split->hasGroup ? split->nameStart - 1 : 0),
+                                            cardStrndup(newCard, line + split->nameStart, split->nameEnd - split->nameStart),
+                                            id);
+    if (newProperty == NULL)
+    {
+        return OTHER_ERROR;
+    }
 
+    err = forEachParameter(line, index, split, addParameterToken, newProperty);
+    if (err != OK)
+    {
+        discardProperty(newCard, newProperty);
+        return err;
+    }
 
+    // Structured values are ';'-separated, lists are ','-separated
+    char delimiter;
+    switch (id)
+    {
+    case PROP_N:
+    case PROP_ADR:
+    case PROP_TEL:
+        delimiter = ';';
+        break;
+    default:
+        delimiter = ',';
+        break;
+    }
+    ValueTarget target = {newCard, newProperty};
 
-        // Assign to the correct field in `Card`
-        if (strstr(line, "BDAY") == line)
+    err = forEachValue(line, length, index, split, delimiter, addValueToken, &target);
+    if (err == OK && raw != NULL && (newProperty->raw = cardStrdup(newCard, raw)) == NULL)
+    {
+        err = OTHER_ERROR;
+    }
+    if (err != OK)
+    {
+        discardProperty(newCard, newProperty);
+        return err;
+    }
+
+    newProperty->hash = hashProperty(newProperty);
+    if (!insertBack(newCard->optionalProperties, newProperty))
+    {
+        discardProperty(newCard, newProperty);
+        return OTHER_ERROR;
+    }
+    return OK;
+}
+
+VCardErrorCode checkLineStructure(const char *line)
+{
+    if (strchr(line, ':') != NULL)
+    {
+        return OK;
+    }
+    return (strncmp(line, "BDAY", 4) == 0 || strncmp(line, "ANNIVERSARY", 11) == 0) ? INV_CARD : OK;
+}
+
+VCardErrorCode classifyPropertyLine(const char *line, const StructuralIndex *index, bool fnFound, PropertySplit *split, PropertyId *id, LineKind *kind)
+{
+    *kind = LINE_IGNORED;
+    *id = PROP_OTHER;
+
+    VCardErrorCode err = splitPropertyLine(line, index, split);
+    if (err == OTHER_ERROR)
+    {
+        // No ':' at all.  Such lines are ignored, except for the date properties.
+        return checkLineStructure(line);
+    }
+    if (err != OK)
+    {
+        return err;
+    }
+
+    *id = propertyIdFromName(line + split->nameStart, split->nameEnd - split->nameStart);
+    *kind = LINE_PROPERTY;
+
+    // Grouped properties are always ordinary optional properties
+    if (split->hasGroup)
+    {
+        return OK;
+    }
+
+    const char *value = line + split->colon + 1;
+    switch (*id)
+    {
+    case PROP_FN:
+        // Only the first FN, without parameters, is allowed
+        if (split->hasParameters || fnFound)
         {
-            if (newCard->birthday != NULL)
-            {
-                deleteDate(newCard->birthday);
-            }
-            newCard->birthday = dt;
+            return INV_PROP;
         }
-        else
+        *kind = LINE_FN;
+        break;
+    case PROP_BDAY:
+    case PROP_ANNIVERSARY:
+        *kind = LINE_DATE;
+        break;
+    case PROP_BEGIN:
+    case PROP_END:
+        if (!split->hasParameters && strncmp(value, "VCARD", 5) == 0)
         {
-            if (newCard->anniversary != NULL)
-            {
-                deleteDate(newCard->anniversary);
-            }
-            newCard->anniversary = dt;
+            *kind = LINE_IGNORED;
         }
-
-        free(value);
+        break;
+    case PROP_VERSION:
+        if (!split->hasParameters && strncmp(value, "4.0", 3) == 0)
+        {
+            *kind = LINE_IGNORED;
+        }
+        break;
+    default:
+        break;
     }
-    else if (strchr(line, ':') != NULL)
+
+    return OK;
+}
+
+PropertyId propertyIdOfLine(const char *line)
+{
+    const char *nameStart = line;
+    const char *c = line;
+
+    // The group dot only counts before the parameters
+    for (; *c != '\0' && *c != ':' && *c != ';'; c++)
     {
-        // Skip header/footer lines
-        if (strncmp(line, "BEGIN:VCARD", 11) == 0 ||
-            strncmp(line, "VERSION:4.0", 11) == 0 ||
-            strncmp(line, "END:VCARD", 9) == 0)
+        if (*c == '.' && nameStart == line)
         {
-            return OK;
+            nameStart = c + 1;
         }
-        else if (strncmp(line, "FN", 2) == 0)
+    }
+
+    if (*c == '\0')
+    {
+        return PROP_OTHER;
+    }
+
+    return propertyIdFromName(nameStart, (size_t)(c - nameStart));
+}
+
+/*	Position of a new FN, BDAY or ANNIVERSARY line for writeCard: RAW_ORDER_STEP times the number of optional
+	properties before it, plus one more than any such line already at that position, so that they keep their
+	order too.
+*/
+static int nextRawOrder(const Card *card)
+{
+    int base = getLength(card->optionalProperties) * RAW_ORDER_STEP;
+    int taken[] = {
+        (card->fn != NULL && card->fn->raw != NULL) ? card->fn->rawOrder : -1,
+        (card->birthday != NULL && card->birthday->raw != NULL) ? card->birthday->rawOrder : -1,
+        (card->anniversary != NULL && card->anniversary->raw != NULL) ? card->anniversary->rawOrder : -1,
+    };
+
+    int order = base;
+    for (size_t i = 0; i < sizeof(taken) / sizeof(taken[0]); i++)
+    {
+        if (taken[i] >= order && taken[i] < base + RAW_ORDER_STEP - 1)
         {
-            return INV_PROP;
+            order = taken[i] + 1;
         }
+    }
+    return order;
+}
+
+static VCardErrorCode addPropertyLine(const char *line, size_t length, const StructuralIndex *index, const char *raw, Card *newCard, bool *fnFound)
+{
+    PropertySplit split;
+    PropertyId id;
+    LineKind kind;
 
-        char *colon = strchr(line, ':');
-        char *nameAndParams = strndup(line, colon - line);
-        char *value = strdup(colon + 1);
+    VCardErrorCode err = classifyPropertyLine(line, index, *fnFound, &split, &id, &kind);
+    if (err != OK)
+    {
+        return err;
+    }
+
+    switch (kind)
+    {
+    case LINE_FN:
+    {
+        *fnFound = true;
 
-        if (nameAndParams == NULL || value == NULL)
+        Property *fnProperty = newCardProperty(newCard, cardStrdup(newCard, ""), cardStrdup(newCard, "FN"), PROP_FN);
+        if (fnProperty == NULL)
         {
-            if(nameAndParams != NULL)
-            {
-                free(nameAndParams);
-            } 
-            if(value != NULL)
-            {
-                free(value);
-            }
             return OTHER_ERROR;
         }
 
-        char *group = strdup("");
-        char *propertyName = NULL;
-        char *dot = strchr(nameAndParams, '.');
-        if (dot != NULL)
+        if (raw != NULL && (fnProperty->raw = cardStrdup(newCard, raw)) == NULL)
         {
-            *dot = '\0';
-            free(group);
-            group = strdup(nameAndParams);
-            propertyName = (*(dot + 1) != '\0') ? strdup(dot + 1) : strdup("");
-        }
-        else
-        {
-            propertyName = strdup(nameAndParams);
+            discardProperty(newCard, fnProperty);
+            return OTHER_ERROR;
         }
+        fnProperty->rawOrder = nextRawOrder(newCard);
 
-        if (propertyName == NULL)
+        char *fnValue = cardStrndup(newCard, line + split.colon + 1, length - split.colon - 1);
+        if (fnValue == NULL)
         {
-            free(nameAndParams);
-            free(value);
-            free(group);
+            discardProperty(newCard, fnProperty);
             return OTHER_ERROR;
         }
 
-        // Split parameters from propertyName, not nameAndParams
-        char *semicolon = strchr(propertyName, ';'); // Key Fix: Use propertyName here
-        char *parameters = semicolon ? strdup(semicolon + 1) : strdup("");
-        if (semicolon != NULL)
+        if (!insertBack(fnProperty->values, fnValue))
         {
-            *semicolon = '\0'; // Truncate propertyName to exclude parameters
+            if (newCard->arena == NULL)
+            {
+                free(fnValue);
+            }
+            discardProperty(newCard, fnProperty);
+            return OTHER_ERROR;
         }
-
-        if (strlen(propertyName) == 0)
+        fnProperty->hash = hashProperty(fnProperty);
+        newCard->fn = fnProperty;
+        return OK;
+    }
+    case LINE_DATE:
+    {
+        DateTime *dt = NULL;
+        err = createDateTime(line, &split, newCard, &dt);
+        if (err != OK)
         {
-            free(nameAndParams);
-            free(propertyName);
-            free(group);
-            free(value);
-            free(parameters);
-            return INV_PROP;
+            return err;
         }
 
-        Property *newProperty = malloc(sizeof(Property));
-        if (newProperty == NULL)
+        if (raw != NULL && (dt->raw = cardStrdup(newCard, raw)) == NULL)
         {
-            free(nameAndParams);
-            free(propertyName);
-            free(group);
-            free(value);
-            free(parameters);
+            discardDate(newCard, dt);
             return OTHER_ERROR;
         }
+        dt->rawOrder = nextRawOrder(newCard);
 
-        newProperty->name = propertyName;
-        newProperty->group = group;
-        newProperty->parameters = initializeList(parameterToString, deleteParameter, compareParameters);
-        newProperty->values = initializeList(valueToString, deleteValue, compareValues);
-
-        char *paramToken = strtok(parameters, ";");
-        while (paramToken != NULL)
+        // Assign to the correct field in `Card`
+        DateTime **field = (id == PROP_BDAY) ? &newCard->birthday : &newCard->anniversary;
+        if (*field != NULL)
         {
-            char *equalsPos = strchr(paramToken, '=');
-            if (equalsPos != NULL)
-            {
-                *equalsPos = '\0';
-                char *value_ = equalsPos + 1;
-
-                if (strcmp(paramToken, "") == 0 || strcmp(value_, "") == 0)
-                {
-                    free(nameAndParams);
-                    free(value);
-                    free(parameters);
-                    free(value_);
-                    return INV_PROP;
-                }
-
-                addParameter(newProperty, paramToken, value_);
-            }
-            else
-            {
-                if (equalsPos == NULL)
-                {
-                    free(nameAndParams);
-                    free(parameters);
-                    // free(paramToken);
-                    free(value);
-                    return INV_PROP;
-                }
-            }
-            paramToken = strtok(NULL, ";");
+            discardDate(newCard, *field);
         }
-        
+        *field = dt;
+        return OK;
+    }
+    case LINE_PROPERTY:
+        return createProperty(line, length, index, &split, id, raw, newCard);
+    default:
+        return OK;
+    }
+}
 
-        char *delimiter = (strcmp(propertyName, "N") == 0 || strcmp(propertyName, "ADR") == 0 || strcmp(propertyName, "TEL") == 0) ? ";" : ",";
-        char *start = value;
-        char *end;
-        size_t delim_len = strlen(delimiter);
+VCardErrorCode createCardHelper(const char *line, Card *newCard, bool *fnFound)
+{
+    return createCardHelperRaw(line, NULL, newCard, fnFound);
+}
+
+VCardErrorCode createCardHelperRaw(const char *line, const char *raw, Card *newCard, bool *fnFound)
+{
+    size_t length = strlen(line);
+    StructuralIndex index;
+    initStructuralIndex(&index);
+
+    VCardErrorCode err = scanStructural(line, length, &index) ? addPropertyLine(line, length, &index, raw, newCard, fnFound) : OTHER_ERROR;
+    freeStructuralIndex(&index);
+
+    return err;
+}
+
+void adoptCard(Card *card)
+{
+    if (card->made != LIBRARY_MADE)
+    {
+        card->arena = NULL;
+        card->index = NULL;
+        card->compactLists = false;
+        card->made = LIBRARY_MADE;
+    }
+}
+
+void adoptProperty(Property *prop)
+{
+    if (prop->made != LIBRARY_MADE)
+    {
+        prop->id = propertyIdFromName(prop->name, prop->name ? strlen(prop->name) : 0);
+        prop->raw = NULL;
+        prop->rawOrder = 0;
+        prop->hash = 0;
+        prop->made = LIBRARY_MADE;
+    }
+}
+
+void adoptDate(DateTime *dt)
+{
+    if (dt->made != LIBRARY_MADE)
+    {
+        dt->raw = NULL;
+        dt->rawOrder = 0;
+        dt->key = 0;
+        dt->made = LIBRARY_MADE;
+    }
+}
+
+const char *propertyRaw(const Property *prop)
+{
+    return prop->made == LIBRARY_MADE ? prop->raw : NULL;
+}
+
+uint64_t propertyHash(const Property *prop)
+{
+    return prop->made == LIBRARY_MADE ? prop->hash : 0;
+}
+
+const char *dateRaw(const DateTime *dt)
+{
+    return dt->made == LIBRARY_MADE ? dt->raw : NULL;
+}
+
+uint64_t dateKey(const DateTime *dt)
+{
+    return dt->made == LIBRARY_MADE ? dt->key : 0;
+}
+
+void markPropertyDirty(Card *card, Property *prop)
+{
+    adoptCard(card);
+    adoptProperty(prop);
+    if (card->arena == NULL)
+    {
+        free(prop->raw);
+    }
+    prop->raw = NULL;
+
+    ListIterator iter = createIterator(prop->parameters);
+    Parameter *param;
+    while ((param = nextElement(&iter)) != NULL)
+    {
+        param->hash = hashParameter(param);
+    }
+    prop->hash = hashProperty(prop);
+}
+
+void markDateDirty(Card *card, DateTime *dt)
+{
+    adoptCard(card);
+    adoptDate(dt);
+    if (card->arena == NULL)
+    {
+        free(dt->raw);
+    }
+    dt->raw = NULL;
+    dt->key = dateTimeKey(dt);
+}
 
-        while ((end = strstr(start, delimiter)) != NULL)
+VCardErrorCode setPropertyValue(Card *card, Property *prop, const char *value)
+{
+    adoptCard(card);
+    char *copy = cardStrdup(card, value);
+    if (copy == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    char *old = replaceFront(prop->values, copy);
+    if (old == NULL && !insertBack(prop->values, copy))
+    {
+        if (card->arena == NULL)
         {
-            *end = '\0'; // Terminate the current token
-            insertBack(newProperty->values, strdup(start));
-            start = end + delim_len; // Move past the delimiter
+            free(copy);
         }
-        insertBack(newProperty->values, strdup(start)); // Add the last token
+        return OTHER_ERROR;
+    }
+    else if (card->arena == NULL)
+    {
+        free(old);
+    }
+
+    markPropertyDirty(card, prop);
+    return OK;
+}
 
-        insertBack(newCard->optionalProperties, newProperty);
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
 
-        free(nameAndParams);
-        free(value);
-        free(parameters);
+// FNV-1a over a string including its NUL, so that "ab", "c" and "a", "bc" hash differently
+static uint64_t hashString(uint64_t hash, const char *str)
+{
+    const unsigned char *c = (const unsigned char *)str;
+    do
+    {
+        hash ^= *c;
+        hash *= FNV_PRIME;
+    } while (*c++ != '\0');
+    return hash;
+}
+
+static uint64_t hashInt(uint64_t hash, uint64_t n)
+{
+    hash ^= n;
+    return hash * FNV_PRIME;
+}
+
+// Spreads FNV's weak low bits over the whole word, for tables indexed by the low bits.  Never returns 0.
+static uint64_t finishHash(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash != 0 ? hash : 1;
+}
+
+uint64_t hashParameter(const Parameter *param)
+{
+    return finishHash(hashString(hashString(FNV_OFFSET, param->name), param->value));
+}
+
+uint64_t hashProperty(const Property *prop)
+{
+    // The counts keep parameters and values from running into each other
+    uint64_t hash = hashString(hashString(FNV_OFFSET, prop->name), prop->group);
+    hash = hashInt(hash, (uint64_t)getLength(prop->parameters));
+    hash = hashInt(hash, (uint64_t)getLength(prop->values));
+
+    ListIterator paramIter = createIterator(prop->parameters);
+    Parameter *param;
+    while ((param = nextElement(&paramIter)) != NULL)
+    {
+        hash = hashString(hashString(hash, param->name), param->value);
     }
 
-    return OK;
+    ListIterator valueIter = createIterator(prop->values);
+    char *value;
+    while ((value = nextElement(&valueIter)) != NULL)
+    {
+        hash = hashString(hash, value);
+    }
+
+    return finishHash(hash);
+}
+
+bool propertiesEqual(const Property *first, const Property *second)
+{
+    uint64_t firstHash = propertyHash(first);
+    uint64_t secondHash = propertyHash(second);
+    if (firstHash != 0 && secondHash != 0 && firstHash != secondHash)
+    {
+        return false;
+    }
+    return compareProperties(first, second) == 0;
 }
@@ -0,0 +1,237 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCIndex.h"
+#include "VCHelpers.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <strings.h>
+
+// Slot of the name and group table.  Keys point into the names and groups of the card's properties.
+typedef struct indexSlot
+{
+    const char *key;
+    uint64_t hash;
+    bool isGroup;
+    List *properties;
+} IndexSlot;
+
+struct propertyIndex
+{
+    // What the index was built from, to notice properties added, removed or replaced since
+    const Property *fn;
+    unsigned long changes;
+
+    // Properties by ID, NULL where there are none.  PROP_OTHER ones are in the table instead.
+    List *byId[PROP_COUNT];
+
+    // Open-addressed table of PROP_OTHER names and of group names, with at most half of the slots used
+    IndexSlot *slots;
+    size_t slotCount;
+};
+
+// The index lists only refer to the card's properties
+static void keepProperty(void *toBeDeleted)
+{
+    (void)toBeDeleted;
+}
+
+// FNV-1a of the upper-cased key, so that lookups ignore case like property names do
+static uint64_t hashKey(const char *key)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *c = (const unsigned char *)key; *c != '\0'; c++)
+    {
+        hash ^= (unsigned char)toupper(*c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void freeIndex(struct propertyIndex *index)
+{
+    if (index == NULL)
+    {
+        return;
+    }
+
+    for (int i = 0; i < PROP_COUNT; i++)
+    {
+        freeList(index->byId[i]);
+    }
+    for (size_t i = 0; i < index->slotCount; i++)
+    {
+        freeList(index->slots[i].properties);
+    }
+    free(index->slots);
+    free(index);
+}
+
+// Returns the slot of a key, which is empty if the key is not in the table
+static IndexSlot *findSlot(const struct propertyIndex *index, const char *key, bool isGroup, uint64_t hash)
+{
+    size_t mask = index->slotCount - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        IndexSlot *slot = &index->slots[i];
+        if (slot->key == NULL || (slot->hash == hash && slot->isGroup == isGroup && strcasecmp(slot->key, key) == 0))
+        {
+            return slot;
+        }
+    }
+}
+
+// Appends prop to *list, creating it first.  Returns false if out of memory.
+static bool addToList(List **list, Property *prop)
+{
+    if (*list == NULL)
+    {
+        *list = initializeListWithStorage(LIST_VECTOR, propertyToString, keepProperty, compareProperties);
+        if (*list == NULL)
+        {
+            return false;
+        }
+    }
+
+    return insertBack(*list, prop);
+}
+
+static bool addToTable(struct propertyIndex *index, const char *key, bool isGroup, Property *prop)
+{
+    uint64_t hash = hashKey(key);
+    IndexSlot *slot = findSlot(index, key, isGroup, hash);
+    if (slot->key == NULL)
+    {
+        slot->key = key;
+        slot->hash = hash;
+        slot->isGroup = isGroup;
+    }
+    return addToList(&slot->properties, prop);
+}
+
+static bool addProperty(struct propertyIndex *index, Property *prop)
+{
+    PropertyId id = propertyIdOf(prop);
+    bool added = (id == PROP_OTHER) ? addToTable(index, prop->name, false, prop) : addToList(&index->byId[id], prop);
+
+    if (added && prop->group != NULL && prop->group[0] != '\0')
+    {
+        added = addToTable(index, prop->group, true, prop);
+    }
+    return added;
+}
+
+// Whether a property needs a slot in the name and group table
+static size_t tableKeys(const Property *prop)
+{
+    return (propertyIdOf(prop) == PROP_OTHER) + (prop->group != NULL && prop->group[0] != '\0');
+}
+
+VCardErrorCode buildPropertyIndex(Card *card)
+{
+    adoptCard(card);
+    dropPropertyIndex(card);
+
+    struct propertyIndex *index = calloc(1, sizeof(struct propertyIndex));
+    if (index == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    index->fn = card->fn;
+    index->changes = card->optionalProperties->changes;
+
+    // Properties built by hand get their id here, once, instead of on every lookup
+    size_t keys = 0;
+    if (card->fn != NULL)
+    {
+        adoptProperty(card->fn);
+        keys += tableKeys(card->fn);
+    }
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
+    {
+        adoptProperty(prop);
+        keys += tableKeys(prop);
+    }
+
+    index->slotCount = 8;
+    while (index->slotCount < keys * 2)
+    {
+        index->slotCount *= 2;
+    }
+    index->slots = calloc(index->slotCount, sizeof(IndexSlot));
+    if (index->slots == NULL)
+    {
+        free(index);
+        return OTHER_ERROR;
+    }
+
+    bool ok = (card->fn == NULL || addProperty(index, card->fn));
+    iter = createIterator(card->optionalProperties);
+    while (ok && (prop = nextElement(&iter)) != NULL)
+    {
+        ok = addProperty(index, prop);
+    }
+
+    if (!ok)
+    {
+        freeIndex(index);
+        return OTHER_ERROR;
+    }
+
+    card->index = index;
+    return OK;
+}
+
+void dropPropertyIndex(Card *card)
+{
+    if (card->made == LIBRARY_MADE)
+    {
+        freeIndex(card->index);
+    }
+    card->index = NULL;
+}
+
+static bool indexIsCurrent(const Card *card)
+{
+    return card->made == LIBRARY_MADE && card->index != NULL && card->index->fn == card->fn && card->index->changes == card->optionalProperties->changes;
+}
+
+// Makes sure the card has an up-to-date index.  Returns false if it could not be built.
+static bool ensureIndex(Card *card)
+{
+    return indexIsCurrent(card) || buildPropertyIndex(card) == OK;
+}
+
+List *getPropertiesById(Card *card, PropertyId id)
+{
+    if (id <= PROP_OTHER || id >= PROP_COUNT || !ensureIndex(card))
+    {
+        return NULL;
+    }
+    return card->index->byId[id];
+}
+
+List *getProperties(Card *card, const char *name)
+{
+    PropertyId id = propertyIdFromName(name, strlen(name));
+    if (id != PROP_OTHER)
+    {
+        return getPropertiesById(card, id);
+    }
+
+    if (name[0] == '\0' || !ensureIndex(card))
+    {
+        return NULL;
+    }
+    return findSlot(card->index, name, false, hashKey(name))->properties;
+}
+
+List *getGroup(Card *card, const char *group)
+{
+    if (group[0] == '\0' || !ensureIndex(card))
+    {
+        return NULL;
+    }
+    return findSlot(card->index, group, true, hashKey(group))->properties;
+}
@@ -0,0 +1,160 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCLazy.h"
+#include "VCHelpers.h"
+
+VCardErrorCode openLazyCard(const char *fileName, LazyCard **obj)
+{
+    if (fileName == NULL || obj == NULL)
+    {
+        return INV_FILE;
+    }
+
+    *obj = NULL;
+
+    LazyCard *lazy = calloc(1, sizeof(LazyCard));
+    if (lazy == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    VCardErrorCode err = openCardView(fileName, &lazy->view);
+    if (err != OK)
+    {
+        free(lazy);
+        return err;
+    }
+
+    lazy->card = newEmptyCard(NULL);
+    lazy->properties = calloc(lazy->view->count ? lazy->view->count : 1, sizeof(Property *));
+    if (lazy->card == NULL || lazy->properties == NULL)
+    {
+        closeLazyCard(lazy);
+        return OTHER_ERROR;
+    }
+
+    *obj = lazy;
+    return OK;
+}
+
+void closeLazyCard(LazyCard *obj)
+{
+    if (obj == NULL)
+    {
+        return;
+    }
+
+    // The materialized properties are owned by the shell card
+    deleteCard(obj->card);
+    free(obj->properties);
+    closeCardView(obj->view);
+    free(obj);
+}
+
+size_t findLazyProperty(const LazyCard *obj, PropertyId id, size_t start)
+{
+    for (size_t i = start; i < obj->view->count; i++)
+    {
+        if (obj->view->properties[i].id == id)
+        {
+            return i;
+        }
+    }
+
+    return obj->view->count;
+}
+
+// Parses one indexed line into the shell card.  The view was fully checked when it was opened.
+static VCardErrorCode materializeLine(LazyCard *obj, const PropertyView *prop, bool fnFound)
+{
+    char *line = copyView(prop->line);
+    if (line == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    VCardErrorCode err = createCardHelper(line, obj->card, &fnFound);
+    free(line);
+
+    return err;
+}
+
+// Whether an indexed line goes into a DateTime field rather than a Property
+static bool isDateLine(const PropertyView *prop)
+{
+    return prop->group.length == 0 && (prop->id == PROP_BDAY || prop->id == PROP_ANNIVERSARY);
+}
+
+VCardErrorCode getLazyFN(LazyCard *obj, Property **prop)
+{
+    if (obj->card->fn == NULL)
+    {
+        VCardErrorCode err = materializeLine(obj, &obj->view->fn, false);
+        if (err != OK)
+        {
+            return err;
+        }
+    }
+
+    *prop = obj->card->fn;
+    return OK;
+}
+
+VCardErrorCode getLazyProperty(LazyCard *obj, size_t i, Property **prop)
+{
+    *prop = NULL;
+
+    if (i >= obj->view->count || isDateLine(&obj->view->properties[i]))
+    {
+        return INV_PROP;
+    }
+
+    if (obj->properties[i] == NULL)
+    {
+        // FN lines in this list are grouped ones, so they never count as the card's FN
+        VCardErrorCode err = materializeLine(obj, &obj->view->properties[i], true);
+        if (err != OK)
+        {
+            return err;
+        }
+        obj->properties[i] = getFromBack(obj->card->optionalProperties);
+    }
+
+    *prop = obj->properties[i];
+    return OK;
+}
+
+VCardErrorCode getLazyDate(LazyCard *obj, PropertyId id, DateTime **dt)
+{
+    *dt = NULL;
+
+    if (id != PROP_BDAY && id != PROP_ANNIVERSARY)
+    {
+        return OTHER_ERROR;
+    }
+
+    DateTime **field = (id == PROP_BDAY) ? &obj->card->birthday : &obj->card->anniversary;
+    if (*field == NULL)
+    {
+        // createCard keeps the last one
+        const PropertyView *last = NULL;
+        for (size_t i = 0; i < obj->view->count; i++)
+        {
+            if (obj->view->properties[i].id == id && isDateLine(&obj->view->properties[i]))
+            {
+                last = &obj->view->properties[i];
+            }
+        }
+
+        if (last != NULL)
+        {
+            VCardErrorCode err = materializeLine(obj, last, true);
+            if (err != OK)
+            {
+                return err;
+            }
+        }
+    }
+
+    *dt = *field;
+    return OK;
+}
@@ -1,28 +1,44 @@
 #define _POSIX_C_SOURCE 200809L
+#include <sys/types.h>
 #include "VCParser.h"
 #include "LinkedListAPI.h"
 #include "VCHelpers.h"
+#include "VCArena.h"
+#include "VCCache.h"
+#include "VCIndex.h"
+#include "VCPool.h"
 #define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool hasCardExtension(const char *fileName)
+{
+    size_t len = strlen(fileName);
+    return len > 4 && (strcasecmp(fileName + len - 4, ".vcf") == 0 || (len > 6 && strcasecmp(fileName + len - 6, ".vcard") == 0));
+}
 
 VCardErrorCode createCard(char *fileName, Card **obj)
+{
+    return createCardWithOptions(fileName, NULL, obj);
+}
+
+VCardErrorCode createCardWithOptions(const char *fileName, const CardParseOptions *options, Card **obj)
 {
     if (fileName == NULL || obj == NULL)
     {
         return INV_FILE;
     }
 
-    /////////////////////////////////////////////////////////////
-
-    // Check file extension (case-insensitive and must be at the end)
-    size_t len = strlen(fileName);
-    if (len <= 4 || (strcasecmp(fileName + len - 4, ".vcf") != 0 && (len <= 6 || strcasecmp(fileName + len - 6, ".vcard") != 0)))
+    if (!hasCardExtension(fileName))
     {
         return INV_FILE;
     }
-    /////////////////////////////////////////////////////////////
 
     FILE *file = fopen(fileName, "r");
     if (file == NULL)
@@ -30,66 +46,261 @@ VCardErrorCode createCard(char *fileName, Card **obj)
         return INV_FILE;
     }
 
-    /////////////////////////////////////////////////////////
+    CardReader reader;
+    initCardReader(&reader, file);
 
-    Card *newCard = (Card *)malloc(sizeof(Card));
-    if (newCard == NULL)
+    bool endConsumed = false;
+    VCardErrorCode err = readNextCard(&reader, options, obj, false, &endConsumed);
+    freeCardReader(&reader);
+    fclose(file);
+
+    // An empty file has no BEGIN:VCARD line at all
+    if (err == OK && *obj == NULL)
     {
-        fclose(file);
-        return OTHER_ERROR;
+        return INV_CARD;
     }
 
-    newCard->fn = NULL;
-    newCard->optionalProperties = initializeList(propertyToString, deleteProperty, compareProperties);
-    newCard->birthday = NULL;
-    newCard->anniversary = NULL;
+    return err;
+}
 
-    if (newCard->optionalProperties == NULL)
+VCardErrorCode createCardFromBuffer(const char *data, size_t length, Card **obj)
+{
+    if (data == NULL || obj == NULL)
     {
-        free(newCard);
-        fclose(file);
-        return OTHER_ERROR;
+        return INV_FILE;
     }
 
-    /////////////////////////////////////////////////////////
+    CardReader reader;
+    initCardReaderFromBuffer(&reader, data, length);
+
+    bool endConsumed = false;
+    VCardErrorCode err = readNextCard(&reader, NULL, obj, false, &endConsumed);
+    freeCardReader(&reader);
+
+    // An empty buffer has no BEGIN:VCARD line at all
+    if (err == OK && *obj == NULL)
+    {
+        return INV_CARD;
+    }
+
+    return err;
+}
+
+void initCardReader(CardReader *reader, FILE *file)
+{
+    reader->file = file;
+    reader->data = NULL;
+    reader->dataLength = 0;
+    reader->dataOffset = 0;
+    reader->line = NULL;
+    reader->lineCapacity = 0;
+    reader->lineLength = 0;
+    reader->logical.data = NULL;
+    reader->logical.length = 0;
+    reader->logical.capacity = 0;
+    reader->raw.data = NULL;
+    reader->raw.length = 0;
+    reader->raw.capacity = 0;
+    reader->keepRaw = false;
+    reader->unread = false;
+    reader->stopAtBegin = false;
+}
+
+void freeCardReader(CardReader *reader)
+{
+    free(reader->line);
+    free(reader->logical.data);
+    free(reader->raw.data);
+    reader->line = NULL;
+    reader->logical.data = NULL;
+    reader->raw.data = NULL;
+}
+
+void initCardReaderFromBuffer(CardReader *reader, const char *data, size_t length)
+{
+    initCardReader(reader, NULL);
+    reader->data = data;
+    reader->dataLength = length;
+}
+
+// Copies the next line of the in-memory source into reader->line, the way getline would
+static bool readBufferLine(CardReader *reader)
+{
+    if (reader->dataOffset >= reader->dataLength)
+    {
+        return false;
+    }
+
+    const char *start = reader->data + reader->dataOffset;
+    size_t remaining = reader->dataLength - reader->dataOffset;
+    const char *newline = memchr(start, '\n', remaining);
+    size_t len = (newline != NULL) ? (size_t)(newline - start) + 1 : remaining;
+
+    if (len + 1 > reader->lineCapacity)
+    {
+        size_t newCapacity = reader->lineCapacity ? reader->lineCapacity : 256;
+        while (len + 1 > newCapacity)
+        {
+            newCapacity *= 2;
+        }
+
+        char *grown = realloc(reader->line, newCapacity);
+        if (grown == NULL)
+        {
+            return false;
+        }
+        reader->line = grown;
+        reader->lineCapacity = newCapacity;
+    }
+
+    memcpy(reader->line, start, len);
+    reader->line[len] = '\0';
+    reader->lineLength = len;
+    reader->dataOffset += len;
+
+    return true;
+}
+
+bool readPhysicalLine(CardReader *reader)
+{
+    if (reader->unread)
+    {
+        reader->unread = false;
+        return true;
+    }
+
+    if (reader->file == NULL)
+    {
+        return readBufferLine(reader);
+    }
+
+    ssize_t len = getline(&reader->line, &reader->lineCapacity, reader->file);
+    if (len < 0)
+    {
+        return false;
+    }
+
+    reader->lineLength = (size_t)len;
+    return true;
+}
+
+bool lineBufferAppend(LineBuffer *buffer, const char *str, size_t len)
+{
+    // Grow geometrically so a line folded n times costs O(total length), not O(n^2)
+    if (buffer->length + len + 1 > buffer->capacity)
+    {
+        size_t newCapacity = buffer->capacity ? buffer->capacity : 256;
+        while (buffer->length + len + 1 > newCapacity)
+        {
+            newCapacity *= 2;
+        }
+
+        char *grown = realloc(buffer->data, newCapacity);
+        if (grown == NULL)
+        {
+            return false;
+        }
+        buffer->data = grown;
+        buffer->capacity = newCapacity;
+    }
+
+    memcpy(buffer->data + buffer->length, str, len);
+    buffer->length += len;
+    buffer->data[buffer->length] = '\0';
+
+    return true;
+}
+
+// Adds a physical line, whose CRLF has been cut off, to the reader's raw text if it keeps one
+static bool appendRawLine(CardReader *reader, const char *line, size_t len)
+{
+    return !reader->keepRaw || (lineBufferAppend(&reader->raw, line, len) && lineBufferAppend(&reader->raw, "\r\n", 2));
+}
+
+// Passes the logical line collected so far, if any, to onLine (or only checks it once *stop is set) and empties it
+static VCardErrorCode flushLogicalLine(CardReader *reader, VCardErrorCode (*onLine)(void *context, const char *line, bool *stop),
+                                       void *context, bool *stop)
+{
+    LineBuffer *buffer = &reader->logical;
+    if (buffer->length > 0)
+    {
+        // Once onLine has all it needs, the rest of the card is only checked for its structure up to END
+        VCardErrorCode err = *stop ? checkLineStructure(buffer->data) : onLine(context, buffer->data, stop);
+        if (err != OK)
+        {
+            return err;
+        }
+    }
+
+    buffer->length = 0;
+    reader->raw.length = 0;
+    return OK;
+}
+
+/* Reads one BEGIN:VCARD ... END:VCARD block, unfolds its lines and passes every logical line except BEGIN,
+   the first VERSION:4.0 and END to onLine.  onLine may set *stop once it needs no more lines; the rest of the
+   card is then only checked with checkLineStructure.  *beginFound stays false if EOF is reached first.
+   Returns INV_CARD if the structure of the block is wrong, or the first error returned by onLine.
+*/
+static VCardErrorCode readCardLines(CardReader *reader, bool skipBlankLines, bool *endConsumed, bool *beginFound,
+                                    VCardErrorCode (*onLine)(void *context, const char *line, bool *stop), void *context)
+{
+    *endConsumed = false;
+    *beginFound = false;
+
+    LineBuffer *buffer = &reader->logical;
+    buffer->length = 0;
 
-    char line[1024];
-    char buffer[1024] = "";
-    bool fnFound = false;
-    bool beginFound = false;
     bool versionFound = false;
     bool endFound = false;
-    bool isFirstLine = true;
+    bool stop = false;
 
-    while (fgets(line, sizeof(line), file) != NULL)
+    while (readPhysicalLine(reader))
     {
+        char *line = reader->line;
+        size_t len = reader->lineLength;
 
-        size_t len = strlen(line);
+        // The card lacks its END:VCARD and the next card starts here
+        if (*beginFound && reader->stopAtBegin && len == 13 && memcmp(line, "BEGIN:VCARD\r\n", 13) == 0)
+        {
+            reader->unread = true;
+            return INV_CARD;
+        }
 
         if (len < 2 || line[len - 1] != '\n' || line[len - 2] != '\r')
         {
-            fclose(file);
             return INV_CARD; // Error code 2
         }
 
-        line[len - 2] = '\0';
+        len -= 2;
+        line[len] = '\0';
 
         // Check for BEGIN:VCARD (must be first line)
-        if (isFirstLine)
+        if (!*beginFound)
         {
+            // Exports often separate cards with empty lines
+            if (skipBlankLines && len == 0)
+            {
+                continue;
+            }
+
             if (strcmp(line, "BEGIN:VCARD") != 0)
             {
-                fclose(file);
                 return INV_CARD;
             }
-            beginFound = true;
-            isFirstLine = false;
+            *beginFound = true;
             continue; // Skip further processing for BEGIN line
         }
 
         // Check for VERSION:4.0 (must appear early)
         if (!versionFound && strcmp(line, "VERSION:4.0") == 0)
         {
+            // VERSION ends the line before it, so a continuation after it does not extend that line
+            VCardErrorCode err = flushLogicalLine(reader, onLine, context, &stop);
+            if (err != OK)
+            {
+                return err;
+            }
             versionFound = true;
             continue; // Skip processing for VERSION line
         }
@@ -98,51 +309,167 @@ VCardErrorCode createCard(char *fileName, Card **obj)
         if (strcmp(line, "END:VCARD") == 0)
         {
             endFound = true;
+            *endConsumed = true;
             break; // Stop processing after END line
         }
 
         if (line[0] == ' ' || line[0] == '\t')
         {
-            strncat(buffer, line + 1, sizeof(buffer) - strlen(buffer) - 1);
+            if (!lineBufferAppend(buffer, line + 1, len - 1) || !appendRawLine(reader, line, len))
+            {
+                return OTHER_ERROR;
+            }
         }
         else
         {
-            if (strlen(buffer) > 0)
+            VCardErrorCode err = flushLogicalLine(reader, onLine, context, &stop);
+            if (err != OK)
             {
-                VCardErrorCode err = createCardHelper(buffer, newCard, &fnFound);
-                if (err != OK)
-                {
-                    return err;
-                }
+                return err;
+            }
+
+            if (!lineBufferAppend(buffer, line, len) || !appendRawLine(reader, line, len))
+            {
+                return OTHER_ERROR;
             }
-            strncpy(buffer, line, sizeof(buffer) - 1);
-            buffer[sizeof(buffer) - 1] = '\0';
         }
     }
 
-    if (strlen(buffer) > 0)
+    // Reached EOF before anything but blank lines
+    if (!*beginFound)
     {
-        VCardErrorCode err = createCardHelper(buffer, newCard, &fnFound);
-        if (err != OK)
+        return OK;
+    }
+
+    VCardErrorCode err = flushLogicalLine(reader, onLine, context, &stop);
+    if (err != OK)
+    {
+        return err;
+    }
+
+    if (!versionFound || !endFound)
+    {
+        return INV_CARD;
+    }
+
+    return OK;
+}
+
+// The card being built by readNextCard
+typedef struct cardBuilder
+{
+    const CardParseOptions *options;
+    Card *card;
+    bool fnFound;
+
+    // Original text of the current line, or NULL if it is not kept
+    const LineBuffer *raw;
+
+    // Mask of the properties to parse, 0 for all
+    uint64_t wanted;
+} CardBuilder;
+
+// Whether a projection of single-valued fields only has found all of them, so the rest of the card can be skipped
+static bool projectionComplete(uint64_t wanted, const Card *card)
+{
+    const uint64_t singles = PROPERTY_BIT(PROP_FN) | PROPERTY_BIT(PROP_BDAY) | PROPERTY_BIT(PROP_ANNIVERSARY);
+
+    if (wanted == 0 || (wanted & ~singles) != 0 || card->fn == NULL)
+    {
+        return false;
+    }
+
+    return ((wanted & PROPERTY_BIT(PROP_BDAY)) == 0 || card->birthday != NULL) &&
+           ((wanted & PROPERTY_BIT(PROP_ANNIVERSARY)) == 0 || card->anniversary != NULL);
+}
+
+// Parses one logical line into the card, unless the projection leaves its property out
+static VCardErrorCode addCardLine(void *context, const char *line, bool *stop)
+{
+    CardBuilder *builder = context;
+
+    if (builder->card == NULL)
+    {
+        builder->card = newEmptyCard(builder->options);
+        if (builder->card == NULL)
         {
-            return err;
+            return OTHER_ERROR;
         }
     }
 
-    fclose(file);
+    if (builder->wanted != 0 && (builder->wanted & PROPERTY_BIT(propertyIdOfLine(line))) == 0)
+    {
+        return checkLineStructure(line);
+    }
+
+    const char *raw = builder->raw ? builder->raw->data : NULL;
+    VCardErrorCode err = createCardHelperRaw(line, raw, builder->card, &builder->fnFound);
+    *stop = (err == OK) && projectionComplete(builder->wanted, builder->card);
+
+    return err;
+}
 
-    if (!beginFound || !versionFound || !endFound || !fnFound)
+VCardErrorCode readNextCard(CardReader *reader, const CardParseOptions *options, Card **obj, bool skipBlankLines, bool *endConsumed)
+{
+    *obj = NULL;
+
+    CardBuilder builder = {options, NULL, false, NULL, 0};
+
+    reader->keepRaw = (options != NULL && options->keepRaw);
+    if (reader->keepRaw)
     {
-        deleteCard(newCard);
-        *obj = NULL;
-        return INV_CARD;
+        builder.raw = &reader->raw;
     }
 
-    *obj = newCard;
+    // FN is always needed, so a projection includes it
+    if (options != NULL && options->properties != 0)
+    {
+        builder.wanted = options->properties | PROPERTY_BIT(PROP_FN);
+    }
+
+    bool beginFound = false;
+    VCardErrorCode err = readCardLines(reader, skipBlankLines, endConsumed, &beginFound, addCardLine, &builder);
+    if (err != OK)
+    {
+        deleteCard(builder.card);
+        return err;
+    }
+
+    if (!beginFound)
+    {
+        return OK;
+    }
 
+    if (!builder.fnFound)
+    {
+        deleteCard(builder.card);
+        return INV_CARD;
+    }
+
+    *obj = builder.card;
     return OK;
 }
 
+Card *makeCard(const char *fn)
+{
+    Card *card = newEmptyCard(NULL);
+    if (card == NULL)
+    {
+        return NULL;
+    }
+
+    card->fn = makeProperty("", "FN");
+    char *value = strdup(fn);
+    if (card->fn == NULL || value == NULL || !insertBack(card->fn->values, value))
+    {
+        free(value);
+        deleteCard(card);
+        return NULL;
+    }
+
+    return card;
+}
+
 void deleteCard(Card *obj)
 {
     // Free all allocated memory for Card and its components
@@ -153,6 +480,15 @@ void deleteCard(Card *obj)
         return;
     }
 
+    dropPropertyIndex(obj);
+
+    // Everything, including obj itself, lives in the arena
+    if (obj->made == LIBRARY_MADE && obj->arena != NULL)
+    {
+        destroyArena(obj->arena);
+        return;
+    }
+
     if (obj->fn != NULL)
     {
         deleteProperty(obj->fn);
@@ -176,163 +512,208 @@ void deleteCard(Card *obj)
     free(obj);
 }
 
-char *cardToString(const Card *obj)
+// Destination of the to-string functions.  Every byte is counted but only what fits in capacity - 1 is stored,
+// so one walk of a card can measure the exact output length and a second one can fill a buffer of that size.
+typedef struct textOutput
 {
+    char *buffer;
+    size_t capacity;
+    size_t length;
+} TextOutput;
 
-    if (obj == NULL)
+static void putText(TextOutput *out, const char *str, size_t len)
+{
+    if (out->length + 1 < out->capacity)
     {
-        return NULL;
+        size_t room = out->capacity - 1 - out->length;
+        memcpy(out->buffer + out->length, str, len < room ? len : room);
     }
+    out->length += len;
+}
 
-    // Allocate buffer for output
-    size_t bufferSize = 8192; // Ensure sufficient space for complex cards
-    char *output = malloc(bufferSize);
-    if (output == NULL)
+static void putString(TextOutput *out, const char *str)
+{
+    if (str != NULL)
     {
-        return NULL;
+        putText(out, str, strlen(str));
     }
-    strcpy(output, "BEGIN:VCARD\nVERSION:4.0\n");
+}
+
+// Terminates whatever was stored and returns the untruncated length
+static size_t finishText(TextOutput *out)
+{
+    if (out->capacity > 0)
+    {
+        out->buffer[out->length < out->capacity ? out->length : out->capacity - 1] = '\0';
+    }
+    return out->length;
+}
+
+// Appends "values" joined by separator
+static void putValues(TextOutput *out, List *values, char separator)
+{
+    ListIterator valueIter = createIterator(values);
+    char *value;
+    bool firstValue = true;
+    while ((value = nextElement(&valueIter)) != NULL)
+    {
+        if (!firstValue)
+        {
+            putText(out, &separator, 1);
+        }
+        putString(out, value);
+        firstValue = false;
+    }
+}
+
+// Appends ";name=value" for each parameter
+static void putParameters(TextOutput *out, List *parameters)
+{
+    ListIterator paramIter = createIterator(parameters);
+    Parameter *param;
+    while ((param = nextElement(&paramIter)) != NULL)
+    {
+        putText(out, ";", 1);
+        putString(out, param->name);
+        putText(out, "=", 1);
+        putString(out, param->value);
+    }
+}
+
+// First N property of a card.  This scans the card rather than trusting its index, which callers may have
+// left stale by editing optionalProperties directly.
+static Property *firstNameProperty(const Card *obj)
+{
+    ListIterator iter = createIterator(obj->optionalProperties);
+    Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
+    {
+        if (propertyIdOf(prop) == PROP_N)
+        {
+            return prop;
+        }
+    }
+    return NULL;
+}
+
+static void putCard(TextOutput *out, const Card *obj)
+{
+    putString(out, "BEGIN:VCARD\nVERSION:4.0\n");
 
     // Add FN property
     if (obj->fn != NULL)
     {
-        strcat(output, "FN:");
-        char *fnValue = (char *)getFromFront(obj->fn->values);
-        strcat(output, fnValue);
-        strcat(output, "\n");
+        putString(out, "FN:");
+        putString(out, (char *)getFromFront(obj->fn->values));
+        putString(out, "\n");
     }
 
     // Add BDAY
     if (obj->birthday != NULL)
     {
-        strcat(output, "BDAY"); // Start property
-
         // Add VALUE=text parameter if needed
-        if (obj->birthday->isText)
-        {
-            strcat(output, ";VALUE=text");
-        }
-
-        strcat(output, ":"); // Add colon separator
+        putString(out, obj->birthday->isText ? "BDAY;VALUE=text:" : "BDAY:");
 
-        // Add value
         if (obj->birthday->isText)
         {
-            strcat(output, obj->birthday->text); // Text value
+            putString(out, obj->birthday->text); // Text value
         }
         else
         {
-            strcat(output, obj->birthday->date); // Date value
+            putString(out, obj->birthday->date); // Date value
             if (obj->birthday->UTC)
             {
-                strcat(output, "Z"); // Add UTC indicator
+                putString(out, "Z"); // Add UTC indicator
             }
         }
 
-        strcat(output, "\n"); // Use CRLF for vCard line endings
+        putString(out, "\n");
     }
 
     // Add ANNIVERSARY
     if (obj->anniversary != NULL)
     {
-        strcat(output, "ANNIVERSARY"); // Start property
-
-        // Add VALUE=text parameter if needed
-        if (obj->anniversary->isText)
-        {
-            strcat(output, ";VALUE=text");
-        }
-
-        strcat(output, ":"); // Add colon separator
+        putString(out, obj->anniversary->isText ? "ANNIVERSARY;VALUE=text:" : "ANNIVERSARY:");
 
-        // Add value
         if (obj->anniversary->isText)
         {
-            strcat(output, obj->anniversary->text); // Text value
+            putString(out, obj->anniversary->text); // Text value
         }
         else
         {
-            strcat(output, obj->anniversary->date); // Date value
-            strcat(output, "T");                    // Date value
-            strcat(output, obj->anniversary->time); // Date value
+            putString(out, obj->anniversary->date);
+            putString(out, "T");
+            putString(out, obj->anniversary->time);
             if (obj->anniversary->UTC)
             {
-                strcat(output, "Z"); // Add UTC indicator
+                putString(out, "Z"); // Add UTC indicator
             }
         }
 
-        strcat(output, "\n"); // Use CRLF for vCard line endings
+        putString(out, "\n");
     }
 
     // Add the N property first if it exists (mandatory after FN)
-    ListIterator iter = createIterator(obj->optionalProperties);
-    Property *prop;
-    while ((prop = nextElement(&iter)) != NULL)
+    Property *prop = firstNameProperty(obj);
+    if (prop != NULL)
     {
-        if (strcmp(prop->name, "N") == 0)
-        {
-            strcat(output, "N:");
-            ListIterator valueIter = createIterator(prop->values);
-            char *value;
-            bool firstValue = true;
-            while ((value = (char *)nextElement(&valueIter)) != NULL)
-            {
-                if (!firstValue)
-                {
-                    strcat(output, ";");
-                }
-                strcat(output, value);
-                firstValue = false;
-            }
-            strcat(output, "\n");
-            break; // Only one N property is expected
-        }
+        putString(out, "N:");
+        putValues(out, prop->values, ';');
+        putString(out, "\n");
     }
 
     // Add remaining optional properties (except N, already added)
-    iter = createIterator(obj->optionalProperties);
+    ListIterator iter = createIterator(obj->optionalProperties);
     while ((prop = nextElement(&iter)) != NULL)
     {
-        if (strcmp(prop->name, "N") == 0)
+        if (propertyIdOf(prop) == PROP_N)
         {
             continue; // Skip N, already processed
         }
 
-        strcat(output, prop->name);
+        putString(out, prop->name);
+        putParameters(out, prop->parameters);
+        putString(out, ":");
+        putValues(out, prop->values, ',');
+        putString(out, "\n");
+    }
 
-        // Add parameters
-        ListIterator paramIter = createIterator(prop->parameters);
-        Parameter *param;
-        while ((param = nextElement(&paramIter)) != NULL)
-        {
-            strcat(output, ";");
-            strcat(output, param->name);
-            strcat(output, "=");
-            strcat(output, param->value);
-        }
+    // Add END:VCARD
+    putString(out, "END:VCARD\n");
+}
 
-        // Add values
-        strcat(output, ":");
-        ListIterator valueIter = createIterator(prop->values);
-        char *value;
-        bool firstValue = true;
-        while ((value = nextElement(&valueIter)) != NULL)
-        {
-            if (!firstValue)
-            {
-                strcat(output, ",");
-            }
-            strcat(output, value);
-            firstValue = false;
-        }
+char *cardToString(const Card *obj)
+{
+    if (obj == NULL)
+    {
+        return NULL;
+    }
+
+    // Measure, then allocate exactly once and fill
+    TextOutput measure = {NULL, 0, 0};
+    putCard(&measure, obj);
 
-        strcat(output, "\n");
+    TextOutput out = {malloc(measure.length + 1), measure.length + 1, 0};
+    if (out.buffer == NULL)
+    {
+        return NULL;
     }
 
-    // Add END:VCARD
-    strcat(output, "END:VCARD\n");
+    putCard(&out, obj);
+    finishText(&out);
 
-    return output;
+    return out.buffer;
+}
+
+size_t cardToStringInto(const Card *obj, char *buf, size_t cap)
+{
+    TextOutput out = {buf, buf != NULL ? cap : 0, 0};
+    if (obj != NULL)
+    {
+        putCard(&out, obj);
+    }
+
+    return finishText(&out);
 }
 
 char *errorToString(VCardErrorCode err)
@@ -372,6 +753,30 @@ char *errorToString(VCardErrorCode err)
 
 ///////////////////////////////////////////////////////////////
 
+Property *makeProperty(const char *group, const char *name)
+{
+    Property *prop = calloc(1, sizeof(Property));
+    if (prop == NULL)
+    {
+        return NULL;
+    }
+
+    prop->group = strdup(group);
+    prop->name = strdup(name);
+    prop->id = propertyIdFromName(name, strlen(name));
+    prop->made = LIBRARY_MADE;
+    prop->parameters = initializeList(parameterToString, deleteParameter, compareParameters);
+    prop->values = initializeList(valueToString, deleteValue, compareValues);
+
+    if (prop->group == NULL || prop->name == NULL || prop->parameters == NULL || prop->values == NULL)
+    {
+        deleteProperty(prop);
+        return NULL;
+    }
+
+    return prop;
+}
+
 void deleteProperty(void *toBeDeleted)
 {
 
@@ -382,8 +787,24 @@ void deleteProperty(void *toBeDeleted)
 
     Property *newProperty = (Property *)toBeDeleted;
 
+    // Properties parsed with compactLists have their lists embedded and come from the pool
+    bool made = (newProperty->made == LIBRARY_MADE);
+    bool parsed = made && newProperty->values == &newProperty->valueList;
+
     free(newProperty->name);
     free(newProperty->group);
+    if (made)
+    {
+        free(newProperty->raw);
+    }
+
+    if (parsed)
+    {
+        clearList(newProperty->parameters);
+        clearList(newProperty->values);
+        poolFree(newProperty, sizeof(Property));
+        return;
+    }
 
     if (newProperty->parameters != NULL)
     {
@@ -473,6 +894,21 @@ int compareProperties(const void *first, const void *second)
     return 0; // Placeholder for testing
 }
 
+static void putProperty(TextOutput *out, const Property *property)
+{
+    // Add group name if it exists
+    if (property->group[0] != '\0')
+    {
+        putString(out, property->group);
+        putString(out, ".");
+    }
+
+    putString(out, property->name);
+    putParameters(out, property->parameters);
+    putString(out, ":");
+    putValues(out, property->values, ',');
+}
+
 char *propertyToString(void *prop)
 {
     if (prop == NULL)
@@ -483,56 +919,43 @@ char *propertyToString(void *prop)
     // Cast the input to a Property type
     Property *property = (Property *)prop;
 
-    // Start with a reasonable buffer size
-    size_t bufferSize = 256;
-    char *buffer = malloc(bufferSize);
-    if (buffer == NULL)
+    TextOutput measure = {NULL, 0, 0};
+    putProperty(&measure, property);
+
+    TextOutput out = {malloc(measure.length + 1), measure.length + 1, 0};
+    if (out.buffer == NULL)
     {
         return NULL;
     }
-    buffer[0] = '\0'; // Initialize buffer as empty string
 
-    // Add group name if it exists
-    if (strlen(property->group) > 0)
-    {
-        strcat(buffer, property->group);
-        strcat(buffer, ".");
-    }
+    putProperty(&out, property);
+    finishText(&out);
 
-    // Add property name
-    strcat(buffer, property->name);
+    return out.buffer;
+}
 
-    // Add parameters
-    ListIterator paramIter = createIterator(property->parameters);
-    Parameter *param;
-    while ((param = nextElement(&paramIter)) != NULL)
+////////////////////////////////////////////////////////////////
+
+Parameter *makeParameter(const char *name, const char *value)
+{
+    Parameter *param = calloc(1, sizeof(Parameter));
+    if (param == NULL)
     {
-        strcat(buffer, ";");
-        strcat(buffer, param->name);
-        strcat(buffer, "=");
-        strcat(buffer, param->value);
+        return NULL;
     }
 
-    // Add values
-    strcat(buffer, ":");
-    ListIterator valueIter = createIterator(property->values);
-    char *value;
-    bool firstValue = true;
-    while ((value = nextElement(&valueIter)) != NULL)
+    param->name = strdup(name);
+    param->value = strdup(value);
+    if (param->name == NULL || param->value == NULL)
     {
-        if (!firstValue)
-        {
-            strcat(buffer, ",");
-        }
-        strcat(buffer, value);
-        firstValue = false;
+        deleteParameter(param);
+        return NULL;
     }
 
-    return buffer;
+    param->hash = hashParameter(param);
+    return param;
 }
 
-////////////////////////////////////////////////////////////////
-
 void deleteParameter(void *toBeDeleted)
 {
     if (toBeDeleted == NULL)
@@ -638,6 +1061,42 @@ char *valueToString(void *val)
 
 ////////////////////////////////////////////////////////////////
 
+// Allocates a DateTime with copies of its three strings and its key
+static DateTime *makeDateTime(const char *date, const char *time, const char *text, bool UTC, bool isText)
+{
+    DateTime *dt = calloc(1, sizeof(DateTime));
+    if (dt == NULL)
+    {
+        return NULL;
+    }
+
+    dt->UTC = UTC;
+    dt->isText = isText;
+    dt->made = LIBRARY_MADE;
+    dt->date = strdup(date);
+    dt->time = strdup(time);
+    dt->text = strdup(text);
+
+    if (dt->date == NULL || dt->time == NULL || dt->text == NULL)
+    {
+        deleteDate(dt);
+        return NULL;
+    }
+
+    dt->key = dateTimeKey(dt);
+    return dt;
+}
+
+DateTime *makeDate(const char *date, const char *time, bool UTC)
+{
+    return makeDateTime(date, time, "", UTC, false);
+}
+
+DateTime *makeTextDate(const char *text)
+{
+    return makeDateTime("", "", text, false, true);
+}
+
 void deleteDate(void *toBeDeleted)
 {
     if (toBeDeleted == NULL)
@@ -649,10 +1108,25 @@ void deleteDate(void *toBeDeleted)
     free(newDateTime->date);
     free(newDateTime->time);
     free(newDateTime->text);
+    if (newDateTime->made == LIBRARY_MADE)
+    {
+        free(newDateTime->raw);
+    }
 
     free(newDateTime);
 }
 
+// Key of a DateTime, computed if it was left 0 (e.g. by code that built the DateTime by hand).  0 for text dates.
+static uint64_t keyOfDate(const DateTime *dt)
+{
+    if (dt->isText)
+    {
+        return 0;
+    }
+    uint64_t key = dateKey(dt);
+    return key != 0 ? key : dateTimeKey(dt);
+}
+
 int compareDates(const void *first, const void *second)
 {
     if (first == NULL || second == NULL)
@@ -663,6 +1137,14 @@ int compareDates(const void *first, const void *second)
     const DateTime *d1 = (const DateTime *)first;
     const DateTime *d2 = (const DateTime *)second;
 
+    // Structured dates order by their keys, so that e.g. --0203 sorts by month and day
+    uint64_t key1 = keyOfDate(d1);
+    uint64_t key2 = keyOfDate(d2);
+    if (key1 != 0 && key2 != 0 && key1 != key2)
+    {
+        return compareDateKeys(key1, key2);
+    }
+
     if (d1->UTC != d2->UTC)
     {
         return (d1->UTC) ? 1 : -1;
@@ -735,124 +1217,282 @@ char *dateToString(void *date)
     return date;
 }
 /////////////////////////////////////////////////////////
-VCardErrorCode writeCard(const char *fileName, const Card *obj)
+// Appends a BDAY or ANNIVERSARY line in vCard format
+static void putDateLine(TextOutput *out, const char *name, const DateTime *dt)
 {
-    if (fileName == NULL || obj == NULL)
-        return WRITE_ERROR;
+    if (dateRaw(dt) != NULL)
+    {
+        putString(out, dateRaw(dt));
+        return;
+    }
 
-    size_t len = strlen(fileName);
-    if (len <= 4 ||
-        (strcasecmp(fileName + len - 4, ".vcf") != 0 &&
-         (len <= 6 || strcasecmp(fileName + len - 6, ".vcard") != 0)))
-        return INV_FILE;
+    putString(out, name);
+    if (dt->isText)
+    {
+        putString(out, ";VALUE=text:");
+        putString(out, dt->text);
+    }
+    else
+    {
+        putString(out, ":");
+        putString(out, dt->date);
+        if (dt->time != NULL && dt->time[0] != '\0')
+        {
+            putString(out, "T");
+            putString(out, dt->time);
+        }
+        if (dt->UTC)
+            putString(out, "Z");
+    }
+    putString(out, "\r\n");
+}
 
-    FILE *file = fopen(fileName, "w");
-    if (file == NULL)
-        return INV_FILE;
+// An unchanged FN, BDAY or ANNIVERSARY line, to be put back where it was
+typedef struct keptLine
+{
+    int order;
+    const char *raw;
+} KeptLine;
 
-    // Write vCard header and version
-    fprintf(file, "BEGIN:VCARD\r\nVERSION:4.0\r\n");
+// Sorts the kept lines of a card by position and returns how many there are
+static size_t keptLines(const Card *obj, KeptLine lines[3])
+{
+    size_t count = 0;
+    if (propertyRaw(obj->fn) != NULL)
+        lines[count++] = (KeptLine){obj->fn->rawOrder, obj->fn->raw};
+    if (obj->birthday != NULL && dateRaw(obj->birthday) != NULL)
+        lines[count++] = (KeptLine){obj->birthday->rawOrder, obj->birthday->raw};
+    if (obj->anniversary != NULL && dateRaw(obj->anniversary) != NULL)
+        lines[count++] = (KeptLine){obj->anniversary->rawOrder, obj->anniversary->raw};
 
-    // Write the FN field (must exist)
-    if (obj->fn && obj->fn->values && getLength(obj->fn->values) > 0)
+    for (size_t i = 1; i < count; i++)
     {
-        fprintf(file, "FN:%s\r\n", (char *)getFromFront(obj->fn->values));
+        for (size_t j = i; j > 0 && lines[j - 1].order > lines[j].order; j--)
+        {
+            KeptLine swap = lines[j];
+            lines[j] = lines[j - 1];
+            lines[j - 1] = swap;
+        }
     }
-    else
+    return count;
+}
+
+// Appends a card in vCard file format, as writeCard saves it.  Unchanged parts of a card parsed with keepRaw
+// are copied as they were in the file.
+static void putCardFile(TextOutput *out, const Card *obj)
+{
+    putString(out, "BEGIN:VCARD\r\nVERSION:4.0\r\n");
+    if (propertyRaw(obj->fn) == NULL)
     {
-        fclose(file);
-        return INV_CARD;
+        putString(out, "FN:");
+        putString(out, (char *)getFromFront(obj->fn->values));
+        putString(out, "\r\n");
     }
 
-    if (obj->birthday != NULL)
+    if (obj->birthday != NULL && dateRaw(obj->birthday) == NULL)
+        putDateLine(out, "BDAY", obj->birthday);
+    if (obj->anniversary != NULL && dateRaw(obj->anniversary) == NULL)
+        putDateLine(out, "ANNIVERSARY", obj->anniversary);
+
+    // Unchanged FN and date lines go back between the same optional properties as in the file
+    KeptLine kept[3];
+    size_t keptCount = keptLines(obj, kept);
+    size_t nextKept = 0;
+    int position = 0;
+
+    ListIterator iter = createIterator(obj->optionalProperties);
+    Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
     {
-        fprintf(file, "BDAY");
-        if (obj->birthday->isText)
+        for (; nextKept < keptCount && kept[nextKept].order / RAW_ORDER_STEP <= position; nextKept++)
         {
-            fprintf(file, ";VALUE=text:");
-            fprintf(file, "%s", obj->birthday->text);
+            putString(out, kept[nextKept].raw);
         }
-        else
+        position++;
+
+        if (propertyRaw(prop) != NULL)
         {
-            fprintf(file, ":");
-            if (obj->birthday->date && strlen(obj->birthday->date) > 0)
-                fprintf(file, "%s", obj->birthday->date);
-            if (obj->birthday->time && strlen(obj->birthday->time) > 0)
-            {
-                fprintf(file, "T");
-                fprintf(file, "%s", obj->birthday->time);
-            }
-            if (obj->birthday->UTC)
-                fprintf(file, "Z");
+            putString(out, prop->raw);
+            continue;
         }
-        fprintf(file, "\r\n");
-    }
-    if (obj->anniversary != NULL)
-    {
-        fprintf(file, "ANNIVERSARY");
-        if (obj->anniversary->isText)
+
+        // List-valued properties are ','-separated, everything else ';'-separated
+        char separator;
+        switch (propertyIdOf(prop))
         {
-            fprintf(file, ";VALUE=text:");
-            fprintf(file, "%s", obj->anniversary->text);
+        case PROP_GEO:
+        case PROP_NOTE:
+        case PROP_CATEGORIES:
+            separator = ',';
+            break;
+        default:
+            separator = ';';
+            break;
         }
-        else
+
+        if (prop->group && prop->group[0] != '\0')
         {
-            fprintf(file, ":");
-            if (obj->anniversary->date && strlen(obj->anniversary->date) > 0)
-                fprintf(file, "%s", obj->anniversary->date);
-            if (obj->anniversary->time && strlen(obj->anniversary->time) > 0)
-            {
-                fprintf(file, "T");
-                fprintf(file, "%s", obj->anniversary->time);
-            }
-            if (obj->anniversary->UTC)
-                fprintf(file, "Z");
+            putString(out, prop->group);
+            putString(out, ".");
         }
-        fprintf(file, "\r\n");
+        putString(out, prop->name);
+        putParameters(out, prop->parameters);
+        putString(out, ":");
+        putValues(out, prop->values, separator);
+        putString(out, "\r\n");
     }
 
-    // Iterate through optional properties.
-    // When the "N" property is printed, immediately follow it with birthday and anniversary lines.
-    ListIterator iter = createIterator(obj->optionalProperties);
-    Property *prop;
-    while ((prop = nextElement(&iter)) != NULL)
+    for (; nextKept < keptCount; nextKept++)
     {
-        // Print group if present.
-        if (prop->group && strlen(prop->group) > 0)
-            fprintf(file, "%s.", prop->group);
-        fprintf(file, "%s", prop->name);
+        putString(out, kept[nextKept].raw);
+    }
 
-        // Print parameters
-        ListIterator paramIter = createIterator(prop->parameters);
-        Parameter *param;
-        while ((param = nextElement(&paramIter)) != NULL)
-        {
-            fprintf(file, ";%s=%s", param->name, param->value);
-        }
-        fprintf(file, ":");
+    putString(out, "END:VCARD\r\n");
+}
+
+size_t cardToFileTextInto(const Card *obj, char *buf, size_t cap)
+{
+    TextOutput out = {buf, buf != NULL ? cap : 0, 0};
+    putCardFile(&out, obj);
+    return finishText(&out);
+}
+
+// Renders a card into one exactly-sized heap buffer.  Returns NULL if out of memory.
+static char *renderCardFile(const Card *obj, size_t *length)
+{
+    size_t needed = cardToFileTextInto(obj, NULL, 0);
+    char *buffer = malloc(needed + 1);
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+
+    *length = cardToFileTextInto(obj, buffer, needed + 1);
+    return buffer;
+}
 
-        // Print property values (use comma for GEO; semicolon for others)
-        ListIterator valueIter = createIterator(prop->values);
-        char *value;
-        bool firstValue = true;
-        while ((value = nextElement(&valueIter)) != NULL)
+bool writeAll(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written < 0)
         {
-            if (!firstValue)
-            {
-                if (strcasecmp(prop->name, "GEO") == 0 || strcasecmp(prop->name, "NOTE") == 0 || strcasecmp(prop->name, "CATEGORIES") == 0)
-                    fprintf(file, ",");
-                else
-                    fprintf(file, ";");
-            }
-            fprintf(file, "%s", value);
-            firstValue = false;
+            if (errno == EINTR)
+                continue;
+            return false;
         }
-        fprintf(file, "\r\n");
+        data += written;
+        length -= (size_t)written;
     }
+    return true;
+}
 
-    fprintf(file, "END:VCARD\r\n");
-    fclose(file);
-    return OK;
+// Flushes the directory entry of fileName, so a rename into it survives a crash
+static bool syncParentDirectory(const char *fileName)
+{
+    const char *slash = strrchr(fileName, '/');
+    char *dir = slash ? strndup(fileName, slash == fileName ? 1 : (size_t)(slash - fileName)) : strdup(".");
+    if (dir == NULL)
+        return false;
+
+    int fd = open(dir, O_RDONLY);
+    free(dir);
+    if (fd < 0)
+        return false;
+
+    bool ok = (fsync(fd) == 0);
+    close(fd);
+    return ok;
+}
+
+int createTempFile(const char *fileName, char **tempName)
+{
+    // A name next to the target, so the rename stays within one file system.  The address of a local
+    // tells concurrent threads apart, and O_EXCL plus the attempt number gets past stale leftovers.
+    size_t nameLen = strlen(fileName) + 48;
+    *tempName = malloc(nameLen);
+    if (*tempName == NULL)
+        return -1;
+
+    int fd = -1;
+    for (int attempt = 0; attempt < 16 && fd < 0; attempt++)
+    {
+        snprintf(*tempName, nameLen, "%s.tmp.%ld.%lx.%d", fileName, (long)getpid(), (unsigned long)(uintptr_t)&fd, attempt);
+        fd = open(*tempName, O_WRONLY | O_CREAT | O_EXCL, 0666);
+        if (fd < 0 && errno != EEXIST)
+            break;
+    }
+    if (fd < 0)
+    {
+        free(*tempName);
+        *tempName = NULL;
+        return -1;
+    }
+
+    // Keep the permissions of the file being replaced
+    struct stat st;
+    if (stat(fileName, &st) == 0)
+        fchmod(fd, st.st_mode & 07777);
+
+    return fd;
+}
+
+VCardErrorCode finishTempFile(int fd, char *tempName, const char *fileName, WriteSync sync, bool ok)
+{
+    if (ok && sync != WRITE_SYNC_NONE)
+        ok = (fsync(fd) == 0);
+    if (close(fd) != 0)
+        ok = false;
+    if (ok)
+        ok = (rename(tempName, fileName) == 0);
+    if (ok && sync == WRITE_SYNC_FILE_AND_DIRECTORY)
+        ok = syncParentDirectory(fileName);
+
+    if (!ok)
+        unlink(tempName);
+    free(tempName);
+
+    if (ok)
+        invalidateCachedCard(fileName);
+    return ok ? OK : WRITE_ERROR;
+}
+
+VCardErrorCode writeCard(const char *fileName, const Card *obj)
+{
+    return writeCardWithOptions(fileName, obj, NULL);
+}
+
+VCardErrorCode writeCardWithOptions(const char *fileName, const Card *obj, const CardWriteOptions *options)
+{
+    if (fileName == NULL || obj == NULL)
+        return WRITE_ERROR;
+
+    if (!hasCardExtension(fileName))
+        return INV_FILE;
+
+    // The FN field must exist
+    if (obj->fn == NULL || obj->fn->values == NULL || getLength(obj->fn->values) == 0)
+        return INV_CARD;
+
+    size_t length;
+    char *data = renderCardFile(obj, &length);
+    if (data == NULL)
+        return OTHER_ERROR;
+
+    // Readers see either the old file or the new one, never a partly written one
+    char *tempName;
+    int fd = createTempFile(fileName, &tempName);
+    if (fd < 0)
+    {
+        free(data);
+        return INV_FILE;
+    }
+
+    bool ok = writeAll(fd, data, length);
+    free(data);
+
+    return finishTempFile(fd, tempName, fileName, options ? options->sync : WRITE_SYNC_NONE, ok);
 }
 
 VCardErrorCode validateCard(const Card *obj)
@@ -875,16 +1515,24 @@ VCardErrorCode validateCard(const Card *obj)
         if (prop->name == NULL || strlen(prop->name) == 0)
             return INV_PROP;
 
+        switch (propertyIdOf(prop))
+        {
         // VERSION must not appear in optionalProperties; if it does, return INV_CARD (error code 2).
-        if (strcasecmp(prop->name, "VERSION") == 0)
+        case PROP_VERSION:
             return INV_CARD;
 
         // BDAY and ANNIVERSARY should not appear in optionalProperties.
-        if (strcasecmp(prop->name, "BDAY") == 0 || strcasecmp(prop->name, "ANNIVERSARY") == 0)
+        case PROP_BDAY:
+        case PROP_ANNIVERSARY:
             return INV_DT;
 
-        if (strcasecmp(prop->name, "KIND") == 0)
+        case PROP_KIND:
             kindCount++;
+            break;
+
+        default:
+            break;
+        }
 
         if (prop->values == NULL || getLength(prop->values) == 0)
             return INV_PROP;
@@ -949,4 +1597,171 @@ VCardErrorCode validateCard(const Card *obj)
     }
 
     return OK;
-}
\ No newline at end of file
+}
+
+// What validateCard would find in the card being read by validateReader
+typedef struct validationState
+{
+    // Reused for every line, so validation allocates nothing per property
+    StructuralIndex index;
+
+    bool fnFound;
+    int kindCount;
+
+    // First error validateCard would report for an optional property
+    VCardErrorCode propertyError;
+
+    // Results for the last BDAY and ANNIVERSARY lines, which are the ones createCard keeps
+    VCardErrorCode birthdayError;
+    VCardErrorCode anniversaryError;
+} ValidationState;
+
+// Applies the checks of createCardHelper and then of validateCard to one logical line
+static VCardErrorCode validateLine(void *context, const char *line, bool *stop)
+{
+    (void)stop;
+    ValidationState *state = context;
+
+    if (!scanStructural(line, strlen(line), &state->index))
+    {
+        return OTHER_ERROR;
+    }
+
+    PropertySplit split;
+    PropertyId id;
+    LineKind kind;
+
+    VCardErrorCode err = classifyPropertyLine(line, &state->index, state->fnFound, &split, &id, &kind);
+    if (err != OK)
+    {
+        return err;
+    }
+
+    switch (kind)
+    {
+    case LINE_FN:
+        state->fnFound = true;
+        break;
+    case LINE_DATE:
+        // A malformed date stops createCard at this line
+        err = checkDateLine(line, strlen(line), &split);
+        if (err != OK)
+        {
+            return err;
+        }
+
+        if (id == PROP_BDAY)
+        {
+            state->birthdayError = validateDateLine(line, &split);
+        }
+        else
+        {
+            state->anniversaryError = validateDateLine(line, &split);
+        }
+        break;
+    case LINE_PROPERTY:
+        err = forEachParameter(line, &state->index, &split, NULL, NULL);
+        if (err != OK)
+        {
+            return err;
+        }
+
+        if (id == PROP_KIND)
+        {
+            state->kindCount++;
+        }
+        else if (state->propertyError == OK && id == PROP_VERSION)
+        {
+            state->propertyError = INV_CARD;
+        }
+        else if (state->propertyError == OK && (id == PROP_BDAY || id == PROP_ANNIVERSARY))
+        {
+            state->propertyError = INV_DT;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return OK;
+}
+
+// Validates the first card of a reader, returning what createCard followed by validateCard would
+static VCardErrorCode validateReader(CardReader *reader)
+{
+    ValidationState state;
+    initStructuralIndex(&state.index);
+    state.fnFound = false;
+    state.kindCount = 0;
+    state.propertyError = OK;
+    state.birthdayError = OK;
+    state.anniversaryError = OK;
+
+    bool beginFound = false;
+    bool endConsumed = false;
+    VCardErrorCode err = readCardLines(reader, false, &endConsumed, &beginFound, validateLine, &state);
+    freeStructuralIndex(&state.index);
+
+    // Parse errors come before validation errors, in the order validateCard checks things
+    if (err != OK)
+    {
+        return err;
+    }
+    if (!beginFound || !state.fnFound)
+    {
+        return INV_CARD;
+    }
+    if (state.propertyError != OK)
+    {
+        return state.propertyError;
+    }
+    if (state.kindCount > 1)
+    {
+        return INV_PROP;
+    }
+    if (state.birthdayError != OK)
+    {
+        return state.birthdayError;
+    }
+
+    return state.anniversaryError;
+}
+
+VCardErrorCode validateFile(const char *fileName)
+{
+    if (fileName == NULL || !hasCardExtension(fileName))
+    {
+        return INV_FILE;
+    }
+
+    FILE *file = fopen(fileName, "r");
+    if (file == NULL)
+    {
+        return INV_FILE;
+    }
+
+    CardReader reader;
+    initCardReader(&reader, file);
+
+    VCardErrorCode err = validateReader(&reader);
+    freeCardReader(&reader);
+    fclose(file);
+
+    return err;
+}
+
+VCardErrorCode validateBuffer(const char *data, size_t length)
+{
+    if (data == NULL)
+    {
+        return INV_FILE;
+    }
+
+    CardReader reader;
+    initCardReaderFromBuffer(&reader, data, length);
+
+    VCardErrorCode err = validateReader(&reader);
+    freeCardReader(&reader);
+
+    return err;
+}
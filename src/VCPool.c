@@ -0,0 +1,366 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCPool.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef POOL_USE_MALLOC
+
+// Objects are rounded up to a multiple of POOL_GRANULE, which keeps every object in a slab aligned
+#define POOL_GRANULE 16
+#define POOL_CLASSES (POOL_MAX_OBJECT / POOL_GRANULE)
+#define POOL_SLAB_SIZE (64 * 1024)
+
+// Free objects move between a thread and the depot in batches of about this many bytes, and a thread keeps at most two batches of each class
+#define POOL_BATCH_BYTES (32 * 1024)
+
+// A free object.  The links overwrite the first bytes of the object.
+typedef struct freeObject
+{
+    struct freeObject *next;
+    // In the first object of a batch in the depot: the next batch
+    struct freeObject *nextBatch;
+} FreeObject;
+
+/*	Start of a slab, which is aligned to POOL_SLAB_SIZE so that the slab of an object is found by masking
+	its address.  The objects follow the header.
+*/
+typedef struct slab
+{
+    struct slab *next;
+    // Free objects of the slab counted by poolTrim
+    size_t freeSeen;
+} Slab;
+
+#define POOL_SLAB_HEADER ((sizeof(Slab) + POOL_GRANULE - 1) / POOL_GRANULE * POOL_GRANULE)
+
+// Free objects of the calling thread, one list per size class, and their lengths
+static _Thread_local FreeObject *freeLists[POOL_CLASSES];
+static _Thread_local size_t freeCounts[POOL_CLASSES];
+static _Thread_local bool registered = false;
+
+// Batches of free objects handed over by threads, and every slab of each class, guarded by depotLock
+static pthread_mutex_t depotLock = PTHREAD_MUTEX_INITIALIZER;
+static FreeObject *depot[POOL_CLASSES];
+static Slab *slabs[POOL_CLASSES];
+
+// Only used for its destructor, which runs when a thread that used the pools exits
+static pthread_key_t exitKey;
+static pthread_once_t exitKeyOnce = PTHREAD_ONCE_INIT;
+
+static size_t sizeClass(size_t size)
+{
+    return (size + POOL_GRANULE - 1) / POOL_GRANULE - 1;
+}
+
+static size_t objectSize(size_t c)
+{
+    return (c + 1) * POOL_GRANULE;
+}
+
+static size_t batchLength(size_t c)
+{
+    return POOL_BATCH_BYTES / objectSize(c);
+}
+
+static size_t objectsPerSlab(size_t c)
+{
+    return (POOL_SLAB_SIZE - POOL_SLAB_HEADER) / objectSize(c);
+}
+
+static Slab *slabOf(FreeObject *object)
+{
+    return (Slab *)((uintptr_t)object & ~(uintptr_t)(POOL_SLAB_SIZE - 1));
+}
+
+// Groups free objects of one class into depot batches
+typedef struct batchBuilder
+{
+    FreeObject *batches;
+    FreeObject *current;
+    size_t length;
+    size_t limit;
+} BatchBuilder;
+
+static void addToBatch(BatchBuilder *builder, FreeObject *object)
+{
+    object->next = builder->current;
+    builder->current = object;
+    if (++builder->length == builder->limit)
+    {
+        builder->current->nextBatch = builder->batches;
+        builder->batches = builder->current;
+        builder->current = NULL;
+        builder->length = 0;
+    }
+}
+
+// Returns the batches built so far, a last short one included
+static FreeObject *finishBatches(BatchBuilder *builder)
+{
+    if (builder->current != NULL)
+    {
+        builder->current->nextBatch = builder->batches;
+        builder->batches = builder->current;
+    }
+    return builder->batches;
+}
+
+// Puts batches into the depot.  depotLock must be held.
+static void depositBatches(size_t c, FreeObject *batches)
+{
+    if (batches == NULL)
+    {
+        return;
+    }
+
+    FreeObject *last = batches;
+    while (last->nextBatch != NULL)
+    {
+        last = last->nextBatch;
+    }
+    last->nextBatch = depot[c];
+    depot[c] = batches;
+}
+
+// Hands every free object of a thread over to the depot
+static void donateFreeLists(FreeObject **lists)
+{
+    FreeObject *batches[POOL_CLASSES];
+    for (size_t c = 0; c < POOL_CLASSES; c++)
+    {
+        BatchBuilder builder = {NULL, NULL, 0, batchLength(c)};
+        for (FreeObject *object = lists[c], *next; object != NULL; object = next)
+        {
+            next = object->next;
+            addToBatch(&builder, object);
+        }
+        batches[c] = finishBatches(&builder);
+        lists[c] = NULL;
+    }
+
+    pthread_mutex_lock(&depotLock);
+    for (size_t c = 0; c < POOL_CLASSES; c++)
+    {
+        depositBatches(c, batches[c]);
+    }
+    pthread_mutex_unlock(&depotLock);
+}
+
+static void donateOnExit(void *lists)
+{
+    donateFreeLists(lists);
+}
+
+static void createExitKey(void)
+{
+    pthread_key_create(&exitKey, donateOnExit);
+}
+
+// Makes sure the free lists of the calling thread are donated when it exits
+static void registerThread(void)
+{
+    pthread_once(&exitKeyOnce, createExitKey);
+    pthread_setspecific(exitKey, freeLists);
+    registered = true;
+}
+
+// Fills the empty free list of class c with a batch from the depot if there is one, else with a new slab
+static bool refill(size_t c)
+{
+    if (!registered)
+    {
+        registerThread();
+    }
+
+    pthread_mutex_lock(&depotLock);
+    FreeObject *adopted = depot[c];
+    if (adopted != NULL)
+    {
+        depot[c] = adopted->nextBatch;
+    }
+    pthread_mutex_unlock(&depotLock);
+
+    if (adopted != NULL)
+    {
+        size_t length = 0;
+        for (FreeObject *object = adopted; object != NULL; object = object->next)
+        {
+            length++;
+        }
+        freeLists[c] = adopted;
+        freeCounts[c] = length;
+        return true;
+    }
+
+    void *memory;
+    if (posix_memalign(&memory, POOL_SLAB_SIZE, POOL_SLAB_SIZE) != 0)
+    {
+        return false;
+    }
+
+    Slab *slab = memory;
+    char *objects = (char *)slab + POOL_SLAB_HEADER;
+    FreeObject *head = NULL;
+    for (size_t i = objectsPerSlab(c); i-- > 0;)
+    {
+        FreeObject *object = (FreeObject *)(objects + i * objectSize(c));
+        object->next = head;
+        head = object;
+    }
+
+    pthread_mutex_lock(&depotLock);
+    slab->next = slabs[c];
+    slabs[c] = slab;
+    pthread_mutex_unlock(&depotLock);
+
+    freeLists[c] = head;
+    freeCounts[c] = objectsPerSlab(c);
+    return true;
+}
+
+// Moves one batch of the free list of class c to the depot, so that objects freed on this thread can be reused by others
+static void spill(size_t c)
+{
+    size_t length = batchLength(c);
+    FreeObject *batch = freeLists[c];
+    FreeObject *last = batch;
+    for (size_t i = 1; i < length; i++)
+    {
+        last = last->next;
+    }
+
+    freeLists[c] = last->next;
+    freeCounts[c] -= length;
+    last->next = NULL;
+    batch->nextBatch = NULL;
+
+    pthread_mutex_lock(&depotLock);
+    depositBatches(c, batch);
+    pthread_mutex_unlock(&depotLock);
+}
+
+// Frees the slabs of class c all of whose objects are in the depot, and returns how many it freed.  depotLock must be held.
+static size_t releaseFreeSlabs(size_t c)
+{
+    for (Slab *slab = slabs[c]; slab != NULL; slab = slab->next)
+    {
+        slab->freeSeen = 0;
+    }
+    for (FreeObject *batch = depot[c]; batch != NULL; batch = batch->nextBatch)
+    {
+        for (FreeObject *object = batch; object != NULL; object = object->next)
+        {
+            slabOf(object)->freeSeen++;
+        }
+    }
+
+    // Rebuild the depot from the objects of the slabs that stay
+    size_t perSlab = objectsPerSlab(c);
+    BatchBuilder builder = {NULL, NULL, 0, batchLength(c)};
+    for (FreeObject *batch = depot[c], *nextBatch; batch != NULL; batch = nextBatch)
+    {
+        nextBatch = batch->nextBatch;
+        for (FreeObject *object = batch, *next; object != NULL; object = next)
+        {
+            next = object->next;
+            if (slabOf(object)->freeSeen < perSlab)
+            {
+                addToBatch(&builder, object);
+            }
+        }
+    }
+    depot[c] = finishBatches(&builder);
+
+    size_t released = 0;
+    for (Slab **link = &slabs[c]; *link != NULL;)
+    {
+        Slab *slab = *link;
+        if (slab->freeSeen == perSlab)
+        {
+            *link = slab->next;
+            free(slab);
+            released++;
+        }
+        else
+        {
+            link = &slab->next;
+        }
+    }
+    return released;
+}
+
+#endif
+
+void *poolAlloc(size_t size)
+{
+#ifdef POOL_USE_MALLOC
+    return malloc(size);
+#else
+    size_t c = sizeClass(size);
+
+    if (freeLists[c] == NULL && !refill(c))
+    {
+        return NULL;
+    }
+
+    FreeObject *object = freeLists[c];
+    freeLists[c] = object->next;
+    freeCounts[c]--;
+    return object;
+#endif
+}
+
+void poolFree(void *object, size_t size)
+{
+#ifdef POOL_USE_MALLOC
+    (void)size;
+    free(object);
+#else
+    if (object == NULL)
+    {
+        return;
+    }
+
+    if (!registered)
+    {
+        registerThread();
+    }
+
+    size_t c = sizeClass(size);
+
+    FreeObject *freed = object;
+    freed->next = freeLists[c];
+    freeLists[c] = freed;
+
+    // Objects that this thread frees but another allocated would otherwise pile up here
+    if (++freeCounts[c] > 2 * batchLength(c))
+    {
+        spill(c);
+    }
+#endif
+}
+
+size_t poolTrim(void)
+{
+#ifdef POOL_USE_MALLOC
+    return 0;
+#else
+    donateFreeLists(freeLists);
+    for (size_t c = 0; c < POOL_CLASSES; c++)
+    {
+        freeCounts[c] = 0;
+    }
+
+    size_t released = 0;
+    pthread_mutex_lock(&depotLock);
+    for (size_t c = 0; c < POOL_CLASSES; c++)
+    {
+        released += releaseFreeSlabs(c);
+    }
+    pthread_mutex_unlock(&depotLock);
+
+    return released * POOL_SLAB_SIZE;
+#endif
+}
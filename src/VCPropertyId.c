@@ -0,0 +1,142 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCParser.h"
+#include "VCHelpers.h"
+#include <strings.h>
+
+/*	Perfect hash of the vCard 4.0 property names.  With the first, second and last characters
+	upper-cased, (c0 + c1 + cLast * 83 + length) % 128 is different for every name, so one table
+	probe and one strncasecmp decide a lookup.
+*/
+#define PROPERTY_HASH_SIZE 128
+#define PROPERTY_NAME_MAX 12
+
+static const unsigned char propertySlots[PROPERTY_HASH_SIZE] = {
+    [0] = PROP_NOTE,
+    [1] = PROP_TITLE,
+    [4] = PROP_ROLE,
+    [7] = PROP_SOURCE,
+    [10] = PROP_IMPP,
+    [11] = PROP_CLIENTPIDMAP,
+    [22] = PROP_LANG,
+    [30] = PROP_ADR,
+    [34] = PROP_END,
+    [36] = PROP_KIND,
+    [40] = PROP_GENDER,
+    [41] = PROP_ORG,
+    [42] = PROP_RELATED,
+    [44] = PROP_GEO,
+    [45] = PROP_UID,
+    [46] = PROP_MEMBER,
+    [49] = PROP_FBURL,
+    [51] = PROP_SOUND,
+    [52] = PROP_PRODID,
+    [53] = PROP_CALURI,
+    [56] = PROP_CALADRURI,
+    [58] = PROP_PHOTO,
+    [59] = PROP_EMAIL,
+    [60] = PROP_LOGO,
+    [64] = PROP_TEL,
+    [76] = PROP_XML,
+    [78] = PROP_URL,
+    [86] = PROP_BEGIN,
+    [94] = PROP_TZ,
+    [96] = PROP_FN,
+    [101] = PROP_BDAY,
+    [103] = PROP_N,
+    [108] = PROP_VERSION,
+    [110] = PROP_KEY,
+    [117] = PROP_ANNIVERSARY,
+    [119] = PROP_CATEGORIES,
+    [124] = PROP_REV,
+    [126] = PROP_NICKNAME,
+};
+
+static const struct
+{
+    const char *name;
+    size_t length;
+} propertyNames[PROP_COUNT] = {
+    [PROP_OTHER] = {"", 0},
+    [PROP_BEGIN] = {"BEGIN", 5},
+    [PROP_END] = {"END", 3},
+    [PROP_SOURCE] = {"SOURCE", 6},
+    [PROP_KIND] = {"KIND", 4},
+    [PROP_XML] = {"XML", 3},
+    [PROP_FN] = {"FN", 2},
+    [PROP_N] = {"N", 1},
+    [PROP_NICKNAME] = {"NICKNAME", 8},
+    [PROP_PHOTO] = {"PHOTO", 5},
+    [PROP_BDAY] = {"BDAY", 4},
+    [PROP_ANNIVERSARY] = {"ANNIVERSARY", 11},
+    [PROP_GENDER] = {"GENDER", 6},
+    [PROP_ADR] = {"ADR", 3},
+    [PROP_TEL] = {"TEL", 3},
+    [PROP_EMAIL] = {"EMAIL", 5},
+    [PROP_IMPP] = {"IMPP", 4},
+    [PROP_LANG] = {"LANG", 4},
+    [PROP_TZ] = {"TZ", 2},
+    [PROP_GEO] = {"GEO", 3},
+    [PROP_TITLE] = {"TITLE", 5},
+    [PROP_ROLE] = {"ROLE", 4},
+    [PROP_LOGO] = {"LOGO", 4},
+    [PROP_ORG] = {"ORG", 3},
+    [PROP_MEMBER] = {"MEMBER", 6},
+    [PROP_RELATED] = {"RELATED", 7},
+    [PROP_CATEGORIES] = {"CATEGORIES", 10},
+    [PROP_NOTE] = {"NOTE", 4},
+    [PROP_PRODID] = {"PRODID", 6},
+    [PROP_REV] = {"REV", 3},
+    [PROP_SOUND] = {"SOUND", 5},
+    [PROP_UID] = {"UID", 3},
+    [PROP_CLIENTPIDMAP] = {"CLIENTPIDMAP", 12},
+    [PROP_URL] = {"URL", 3},
+    [PROP_VERSION] = {"VERSION", 7},
+    [PROP_KEY] = {"KEY", 3},
+    [PROP_FBURL] = {"FBURL", 5},
+    [PROP_CALADRURI] = {"CALADRURI", 9},
+    [PROP_CALURI] = {"CALURI", 6},
+};
+
+static unsigned upperAscii(char c)
+{
+    return (c >= 'a' && c <= 'z') ? (unsigned)(c - 'a' + 'A') : (unsigned char)c;
+}
+
+PropertyId propertyIdFromName(const char *name, size_t length)
+{
+    if (name == NULL || length == 0 || length > PROPERTY_NAME_MAX)
+    {
+        return PROP_OTHER;
+    }
+
+    unsigned hash = upperAscii(name[0]) + upperAscii(name[length > 1 ? 1 : 0]) + upperAscii(name[length - 1]) * 83 + (unsigned)length;
+    PropertyId id = (PropertyId)propertySlots[hash % PROPERTY_HASH_SIZE];
+
+    if (id != PROP_OTHER && propertyNames[id].length == length && strncasecmp(propertyNames[id].name, name, length) == 0)
+    {
+        return id;
+    }
+
+    return PROP_OTHER;
+}
+
+const char *propertyIdToName(PropertyId id)
+{
+    if (id < PROP_OTHER || id >= PROP_COUNT)
+    {
+        return "";
+    }
+
+    return propertyNames[id].name;
+}
+
+PropertyId propertyIdOf(const Property *prop)
+{
+    // The parser and makeProperty set the id, and the index and CardStore set it in other properties they are given
+    if (prop->made == LIBRARY_MADE)
+    {
+        return prop->id;
+    }
+
+    return prop->name != NULL ? propertyIdFromName(prop->name, strlen(prop->name)) : PROP_OTHER;
+}
@@ -0,0 +1,141 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCPropertySet.h"
+#include "VCHelpers.h"
+#include <stdint.h>
+
+#define SET_INITIAL_SLOTS 16
+
+typedef struct setSlot
+{
+    const Property *prop;
+    uint64_t hash;
+} SetSlot;
+
+struct propertySet
+{
+    // Open-addressed with linear probing, at most half full
+    SetSlot *slots;
+    size_t slotCount;
+    size_t count;
+};
+
+static uint64_t hashOf(const Property *prop)
+{
+    uint64_t hash = propertyHash(prop);
+    return hash != 0 ? hash : hashProperty(prop);
+}
+
+PropertySet *createPropertySet(void)
+{
+    PropertySet *set = malloc(sizeof(PropertySet));
+    if (set == NULL)
+    {
+        return NULL;
+    }
+
+    set->slots = calloc(SET_INITIAL_SLOTS, sizeof(SetSlot));
+    if (set->slots == NULL)
+    {
+        free(set);
+        return NULL;
+    }
+    set->slotCount = SET_INITIAL_SLOTS;
+    set->count = 0;
+
+    return set;
+}
+
+void freePropertySet(PropertySet *set)
+{
+    if (set == NULL)
+    {
+        return;
+    }
+
+    free(set->slots);
+    free(set);
+}
+
+// Returns the slot holding a property equal to prop, or the empty slot where it belongs
+static SetSlot *findSlot(const PropertySet *set, const Property *prop, uint64_t hash)
+{
+    size_t mask = set->slotCount - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        SetSlot *slot = &set->slots[i];
+        if (slot->prop == NULL || (slot->hash == hash && compareProperties(slot->prop, prop) == 0))
+        {
+            return slot;
+        }
+    }
+}
+
+// Doubles the slots once the set is half full.  Returns false if out of memory.
+static bool growSlots(PropertySet *set)
+{
+    if ((set->count + 1) * 2 <= set->slotCount)
+    {
+        return true;
+    }
+
+    size_t newCount = set->slotCount * 2;
+    SetSlot *grown = calloc(newCount, sizeof(SetSlot));
+    if (grown == NULL)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < set->slotCount; i++)
+    {
+        if (set->slots[i].prop == NULL)
+        {
+            continue;
+        }
+
+        size_t j = set->slots[i].hash & (newCount - 1);
+        while (grown[j].prop != NULL)
+        {
+            j = (j + 1) & (newCount - 1);
+        }
+        grown[j] = set->slots[i];
+    }
+
+    free(set->slots);
+    set->slots = grown;
+    set->slotCount = newCount;
+    return true;
+}
+
+VCardErrorCode addToPropertySet(PropertySet *set, const Property *prop, bool *added)
+{
+    *added = false;
+
+    uint64_t hash = hashOf(prop);
+    if (findSlot(set, prop, hash)->prop != NULL)
+    {
+        return OK;
+    }
+
+    if (!growSlots(set))
+    {
+        return OTHER_ERROR;
+    }
+
+    SetSlot *slot = findSlot(set, prop, hash);
+    slot->prop = prop;
+    slot->hash = hash;
+    set->count++;
+
+    *added = true;
+    return OK;
+}
+
+const Property *findInPropertySet(const PropertySet *set, const Property *prop)
+{
+    return findSlot(set, prop, hashOf(prop))->prop;
+}
+
+size_t propertySetSize(const PropertySet *set)
+{
+    return set->count;
+}
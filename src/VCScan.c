@@ -0,0 +1,321 @@
+#include "VCScan.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+// Number of bytes one vector step covers, used to reserve room before each step
+#define SCAN_MAX_STEP 32
+
+static const char structuralChars[] = {':', ';', ',', '.', '=', '\\', '\r', '\n'};
+
+static bool isStructural(unsigned char c)
+{
+    return c == ':' || c == ';' || c == ',' || c == '.' || c == '=' || c == '\\' || c == '\r' || c == '\n';
+}
+
+void initStructuralIndex(StructuralIndex *index)
+{
+    index->positions = index->inlinePositions;
+    index->count = 0;
+    index->capacity = STRUCTURAL_INLINE_POSITIONS;
+}
+
+void freeStructuralIndex(StructuralIndex *index)
+{
+    if (index->positions != index->inlinePositions)
+    {
+        free(index->positions);
+    }
+    initStructuralIndex(index);
+}
+
+static bool reservePositions(StructuralIndex *index, size_t extra)
+{
+    if (index->count + extra <= index->capacity)
+    {
+        return true;
+    }
+
+    size_t newCapacity = index->capacity * 2;
+    while (newCapacity < index->count + extra)
+    {
+        newCapacity *= 2;
+    }
+
+    uint32_t *grown;
+    if (index->positions == index->inlinePositions)
+    {
+        grown = malloc(newCapacity * sizeof(uint32_t));
+        if (grown != NULL)
+        {
+            memcpy(grown, index->positions, index->count * sizeof(uint32_t));
+        }
+    }
+    else
+    {
+        grown = realloc(index->positions, newCapacity * sizeof(uint32_t));
+    }
+
+    if (grown == NULL)
+    {
+        return false;
+    }
+
+    index->positions = grown;
+    index->capacity = newCapacity;
+    return true;
+}
+
+// Appends base + the position of every set bit of mask
+static void emitMask(StructuralIndex *index, size_t base, uint32_t mask)
+{
+    while (mask != 0)
+    {
+        index->positions[index->count++] = (uint32_t)(base + (size_t)__builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+}
+
+#ifdef SCAN_X86
+__attribute__((target("avx2"))) static size_t scanAVX2(const char *line, size_t length, StructuralIndex *index, bool *ok)
+{
+    __m256i targets[sizeof(structuralChars)];
+    for (size_t t = 0; t < sizeof(structuralChars); t++)
+    {
+        targets[t] = _mm256_set1_epi8(structuralChars[t]);
+    }
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32)
+    {
+        if (index->count + SCAN_MAX_STEP > index->capacity && !reservePositions(index, SCAN_MAX_STEP))
+        {
+            *ok = false;
+            return i;
+        }
+
+        __m256i block = _mm256_loadu_si256((const __m256i *)(line + i));
+        __m256i hits = _mm256_cmpeq_epi8(block, targets[0]);
+        for (size_t t = 1; t < sizeof(structuralChars); t++)
+        {
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, targets[t]));
+        }
+        emitMask(index, i, (uint32_t)_mm256_movemask_epi8(hits));
+    }
+
+    return i;
+}
+
+__attribute__((target("sse2"))) static size_t scanSSE2(const char *line, size_t length, StructuralIndex *index, bool *ok)
+{
+    __m128i targets[sizeof(structuralChars)];
+    for (size_t t = 0; t < sizeof(structuralChars); t++)
+    {
+        targets[t] = _mm_set1_epi8(structuralChars[t]);
+    }
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        if (index->count + SCAN_MAX_STEP > index->capacity && !reservePositions(index, SCAN_MAX_STEP))
+        {
+            *ok = false;
+            return i;
+        }
+
+        __m128i block = _mm_loadu_si128((const __m128i *)(line + i));
+        __m128i hits = _mm_cmpeq_epi8(block, targets[0]);
+        for (size_t t = 1; t < sizeof(structuralChars); t++)
+        {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, targets[t]));
+        }
+        emitMask(index, i, (uint32_t)_mm_movemask_epi8(hits));
+    }
+
+    return i;
+}
+#endif
+
+bool scanStructural(const char *line, size_t length, StructuralIndex *index)
+{
+    index->count = 0;
+
+    if (length > UINT32_MAX)
+    {
+        return false;
+    }
+
+    bool ok = true;
+    size_t i = 0;
+
+#ifdef SCAN_X86
+    if (__builtin_cpu_supports("avx2"))
+    {
+        i = scanAVX2(line, length, index, &ok);
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        i = scanSSE2(line, length, index, &ok);
+    }
+#endif
+
+    if (!ok)
+    {
+        return false;
+    }
+
+    // Scalar tail, and the whole line on targets without a vector path
+    for (; i < length; i++)
+    {
+        if (isStructural((unsigned char)line[i]))
+        {
+            if (index->count == index->capacity && !reservePositions(index, 1))
+            {
+                return false;
+            }
+            index->positions[index->count++] = (uint32_t)i;
+        }
+    }
+
+    return true;
+}
+
+VCardErrorCode splitPropertyLine(const char *line, const StructuralIndex *index, PropertySplit *split)
+{
+    bool hasDot = false;
+    size_t dot = 0;
+    bool hasSemicolon = false;
+    size_t semicolon = 0;
+
+    for (size_t entry = 0; entry < index->count; entry++)
+    {
+        size_t pos = index->positions[entry];
+        char c = line[pos];
+
+        if (c == ':')
+        {
+            split->hasGroup = hasDot;
+            split->nameStart = hasDot ? dot + 1 : 0;
+            split->nameEnd = hasSemicolon ? semicolon : pos;
+            split->hasParameters = hasSemicolon;
+            split->colon = pos;
+            split->colonEntry = entry;
+
+            return (split->nameStart == split->nameEnd) ? INV_PROP : OK;
+        }
+
+        if (c == ';' && !hasSemicolon)
+        {
+            hasSemicolon = true;
+            semicolon = pos;
+        }
+        else if (c == '.' && !hasDot && !hasSemicolon)
+        {
+            hasDot = true;
+            dot = pos;
+        }
+    }
+
+    return OTHER_ERROR;
+}
+
+VCardErrorCode forEachParameter(const char *line, const StructuralIndex *index, const PropertySplit *split,
+                                VCardErrorCode (*onParameter)(void *context, const char *name, size_t nameLen, const char *value, size_t valueLen),
+                                void *context)
+{
+    if (!split->hasParameters)
+    {
+        return OK;
+    }
+
+    size_t tokenStart = split->nameEnd + 1;
+    bool hasEquals = false;
+    size_t equals = 0;
+
+    // Entries up to and including the colon; the colon ends the last token
+    for (size_t entry = 0; entry <= split->colonEntry; entry++)
+    {
+        size_t pos = index->positions[entry];
+        if (pos < tokenStart)
+        {
+            continue;
+        }
+
+        char c = line[pos];
+        if (c == '=' && !hasEquals)
+        {
+            hasEquals = true;
+            equals = pos;
+            continue;
+        }
+
+        if (c != ';' && c != ':')
+        {
+            continue;
+        }
+
+        // Empty tokens (";;") are skipped, as strtok used to do
+        if (pos > tokenStart)
+        {
+            if (!hasEquals || equals == tokenStart || equals + 1 == pos)
+            {
+                return INV_PROP;
+            }
+
+            if (onParameter != NULL)
+            {
+                VCardErrorCode err = onParameter(context, line + tokenStart, equals - tokenStart, line + equals + 1, pos - equals - 1);
+                if (err != OK)
+                {
+                    return err;
+                }
+            }
+        }
+
+        tokenStart = pos + 1;
+        hasEquals = false;
+    }
+
+    return OK;
+}
+
+VCardErrorCode forEachValue(const char *line, size_t length, const StructuralIndex *index, const PropertySplit *split, char delimiter,
+                            VCardErrorCode (*onValue)(void *context, const char *value, size_t valueLen),
+                            void *context)
+{
+    size_t start = split->colon + 1;
+
+    // Position right after an unescaped backslash, i.e. the character it escapes
+    size_t escaped = SIZE_MAX;
+
+    for (size_t entry = split->colonEntry + 1; entry < index->count; entry++)
+    {
+        size_t pos = index->positions[entry];
+        char c = line[pos];
+
+        if (c == '\\')
+        {
+            if (pos != escaped)
+            {
+                escaped = pos + 1;
+            }
+            continue;
+        }
+
+        if (c == delimiter && pos != escaped)
+        {
+            VCardErrorCode err = onValue(context, line + start, pos - start);
+            if (err != OK)
+            {
+                return err;
+            }
+            start = pos + 1;
+        }
+    }
+
+    return onValue(context, line + start, length - start);
+}
@@ -0,0 +1,794 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCStore.h"
+#include "VCHelpers.h"
+#include "VCPool.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <strings.h>
+
+#define TABLE_INITIAL_SLOTS 16
+
+// A key of a card in one of the hash indexes
+typedef struct storeKey
+{
+    StoreIndex index;
+    char *key;
+    int position; // of the card in the key's bucket
+} StoreKey;
+
+// What the store knows about one of its cards.  Entries with a family name are also the nodes of the family tree.
+typedef struct storeEntry
+{
+    Card *card;
+
+    StoreKey *keys;
+    size_t keyCount;
+
+    char *family; // NULL if the card has no N
+    struct storeEntry *left;
+    struct storeEntry *right;
+    int height;
+} StoreEntry;
+
+typedef struct tableSlot
+{
+    const void *key; // a Card, or a string owned by the slot; NULL for an empty slot
+    uint64_t hash;
+    void *value; // the card's StoreEntry, or the vector List of cards with the key
+} TableSlot;
+
+// Open-addressed with linear probing, at most half full
+typedef struct storeTable
+{
+    TableSlot *slots;
+    size_t slotCount;
+    size_t count;
+    bool stringKeys;
+} StoreTable;
+
+struct cardStore
+{
+    StoreTable cards;
+    StoreTable byKey[STORE_INDEXES];
+    StoreEntry *families;
+};
+
+// The bucket lists only refer to the store's cards
+static void keepCard(void *toBeDeleted)
+{
+    (void)toBeDeleted;
+}
+
+static char *printCard(void *toBePrinted)
+{
+    return cardToString(toBePrinted);
+}
+
+static int compareCards(const void *first, const void *second)
+{
+    uintptr_t a = (uintptr_t)first;
+    uintptr_t b = (uintptr_t)second;
+    return (a > b) - (a < b);
+}
+
+// FNV-1a of the upper-cased key, so that keys match in any case
+static uint64_t hashString(const char *key)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *c = (const unsigned char *)key; *c != '\0'; c++)
+    {
+        hash ^= (unsigned char)toupper(*c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t hashPointer(const void *key)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)key;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static bool initTable(StoreTable *table, bool stringKeys)
+{
+    table->slots = calloc(TABLE_INITIAL_SLOTS, sizeof(TableSlot));
+    table->slotCount = TABLE_INITIAL_SLOTS;
+    table->count = 0;
+    table->stringKeys = stringKeys;
+    return table->slots != NULL;
+}
+
+// Returns the slot of a key, which is empty if the key is not in the table
+static TableSlot *findSlot(const StoreTable *table, const void *key, uint64_t hash)
+{
+    size_t mask = table->slotCount - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        TableSlot *slot = &table->slots[i];
+        if (slot->key == NULL)
+        {
+            return slot;
+        }
+        if (slot->hash == hash && (table->stringKeys ? strcasecmp(slot->key, key) == 0 : slot->key == key))
+        {
+            return slot;
+        }
+    }
+}
+
+// Makes room for n more keys, doubling the slots as needed.  Returns false if out of memory.
+static bool reserveSlots(StoreTable *table, size_t n)
+{
+    size_t newCount = table->slotCount;
+    while ((table->count + n) * 2 > newCount)
+    {
+        newCount *= 2;
+    }
+    if (newCount == table->slotCount)
+    {
+        return true;
+    }
+
+    TableSlot *grown = calloc(newCount, sizeof(TableSlot));
+    if (grown == NULL)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < table->slotCount; i++)
+    {
+        if (table->slots[i].key == NULL)
+        {
+            continue;
+        }
+
+        size_t j = table->slots[i].hash & (newCount - 1);
+        while (grown[j].key != NULL)
+        {
+            j = (j + 1) & (newCount - 1);
+        }
+        grown[j] = table->slots[i];
+    }
+
+    free(table->slots);
+    table->slots = grown;
+    table->slotCount = newCount;
+    return true;
+}
+
+// Empties a slot, moving later slots of the same probe run back so that no lookup stops early
+static void removeSlot(StoreTable *table, TableSlot *slot)
+{
+    size_t mask = table->slotCount - 1;
+    size_t hole = (size_t)(slot - table->slots);
+
+    for (size_t i = (hole + 1) & mask; table->slots[i].key != NULL; i = (i + 1) & mask)
+    {
+        // The slot at i may fill the hole unless its home lies after the hole
+        size_t home = table->slots[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            table->slots[hole] = table->slots[i];
+            hole = i;
+        }
+    }
+
+    table->slots[hole].key = NULL;
+    table->slots[hole].value = NULL;
+    table->count--;
+}
+
+/*	Turns a value into the key it is indexed under: TEL values keep their digits and a leading '+' (from
+	"tel:+1-519-555-0100" or "+1 (519) 555-0100" alike), other values are kept as they are.  Returns NULL if
+	out of memory, and an empty string for a TEL value without digits.
+*/
+static char *normalizeKey(StoreIndex index, const char *value)
+{
+    if (index != STORE_BY_TEL)
+    {
+        return strdup(value);
+    }
+
+    char *key = malloc(strlen(value) + 1);
+    if (key == NULL)
+    {
+        return NULL;
+    }
+
+    size_t length = 0;
+    for (const char *c = value; *c != '\0'; c++)
+    {
+        if (isdigit((unsigned char)*c) || (*c == '+' && length == 0))
+        {
+            key[length++] = *c;
+        }
+    }
+    key[length] = '\0';
+
+    // A lone '+' is no number
+    if (length == 1 && key[0] == '+')
+    {
+        key[0] = '\0';
+    }
+    return key;
+}
+
+static void freeKeys(StoreKey *keys, size_t keyCount)
+{
+    for (size_t i = 0; i < keyCount; i++)
+    {
+        free(keys[i].key);
+    }
+    free(keys);
+}
+
+// Adds the key of a value to an entry, unless it has it already.  Returns false if out of memory.
+static bool addKey(StoreEntry *entry, StoreIndex index, const char *value)
+{
+    if (value == NULL)
+    {
+        return true;
+    }
+
+    char *key = normalizeKey(index, value);
+    if (key == NULL)
+    {
+        return false;
+    }
+
+    bool known = (key[0] == '\0');
+    for (size_t i = 0; i < entry->keyCount && !known; i++)
+    {
+        known = (entry->keys[i].index == index && strcasecmp(entry->keys[i].key, key) == 0);
+    }
+    if (known)
+    {
+        free(key);
+        return true;
+    }
+
+    StoreKey *grown = realloc(entry->keys, (entry->keyCount + 1) * sizeof(StoreKey));
+    if (grown == NULL)
+    {
+        free(key);
+        return false;
+    }
+
+    entry->keys = grown;
+    entry->keys[entry->keyCount].index = index;
+    entry->keys[entry->keyCount].key = key;
+    entry->keyCount++;
+    return true;
+}
+
+static const char *firstValue(Property *prop)
+{
+    return (prop != NULL && prop->values != NULL) ? getFromFront(prop->values) : NULL;
+}
+
+/*	Fills entry->keys and entry->family from the card's FN, EMAIL, TEL and N properties.  The family name is
+	the first value of the first N.  Returns false if out of memory, leaving whatever was collected.
+*/
+static bool collectKeys(StoreEntry *entry, Card *card)
+{
+    entry->keys = NULL;
+    entry->keyCount = 0;
+    entry->family = NULL;
+
+    if (!addKey(entry, STORE_BY_FN, firstValue(card->fn)))
+    {
+        return false;
+    }
+
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
+    {
+        bool ok = true;
+        adoptProperty(prop);
+        switch (propertyIdOf(prop))
+        {
+        case PROP_FN:
+            ok = addKey(entry, STORE_BY_FN, firstValue(prop));
+            break;
+        case PROP_EMAIL:
+            ok = addKey(entry, STORE_BY_EMAIL, firstValue(prop));
+            break;
+        case PROP_TEL:
+            ok = addKey(entry, STORE_BY_TEL, firstValue(prop));
+            break;
+        case PROP_N:
+            if (entry->family == NULL && firstValue(prop) != NULL)
+            {
+                ok = (entry->family = strdup(firstValue(prop))) != NULL;
+            }
+            break;
+        default:
+            break;
+        }
+
+        if (!ok)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static StoreEntry *findEntry(const CardStore *store, const Card *card);
+
+// Frees the bucket of a slot once its last card is gone
+static void dropEmptyBucket(StoreTable *table, TableSlot *slot)
+{
+    if (getLength(slot->value) == 0)
+    {
+        freeList(slot->value);
+        free((char *)slot->key);
+        removeSlot(table, slot);
+    }
+}
+
+/*	Removes the card of an entry from the buckets of its first n keys.  The last card of each bucket takes the
+	removed card's place, so that removing is O(1) however many cards share the key.
+*/
+static void unindexKeys(CardStore *store, StoreEntry *entry, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        StoreKey *key = &entry->keys[i];
+        StoreTable *table = &store->byKey[key->index];
+        TableSlot *slot = findSlot(table, key->key, hashString(key->key));
+        List *bucket = slot->value;
+
+        Card *moved = bucket->items[bucket->length - 1];
+        bucket->items[key->position] = moved;
+        bucket->length--;
+
+        if (moved != entry->card)
+        {
+            StoreEntry *movedEntry = findEntry(store, moved);
+            for (size_t k = 0; k < movedEntry->keyCount; k++)
+            {
+                if (movedEntry->keys[k].index == key->index && strcasecmp(movedEntry->keys[k].key, key->key) == 0)
+                {
+                    movedEntry->keys[k].position = key->position;
+                    break;
+                }
+            }
+        }
+
+        dropEmptyBucket(table, slot);
+    }
+}
+
+// Adds the card of an entry to the buckets of all its keys.  Returns false if out of memory, leaving none added.
+static bool indexKeys(CardStore *store, StoreEntry *entry)
+{
+    size_t perIndex[STORE_INDEXES] = {0};
+    for (size_t i = 0; i < entry->keyCount; i++)
+    {
+        perIndex[entry->keys[i].index]++;
+    }
+    for (int index = 0; index < STORE_INDEXES; index++)
+    {
+        if (!reserveSlots(&store->byKey[index], perIndex[index]))
+        {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < entry->keyCount; i++)
+    {
+        StoreTable *table = &store->byKey[entry->keys[i].index];
+        uint64_t hash = hashString(entry->keys[i].key);
+        TableSlot *slot = findSlot(table, entry->keys[i].key, hash);
+
+        if (slot->key == NULL)
+        {
+            char *key = strdup(entry->keys[i].key);
+            List *bucket = initializeListWithStorage(LIST_VECTOR, printCard, keepCard, compareCards);
+            if (key == NULL || bucket == NULL)
+            {
+                free(key);
+                freeList(bucket);
+                unindexKeys(store, entry, i);
+                return false;
+            }
+
+            slot->key = key;
+            slot->hash = hash;
+            slot->value = bucket;
+            table->count++;
+        }
+
+        List *bucket = slot->value;
+        entry->keys[i].position = getLength(bucket);
+        if (!insertBack(bucket, entry->card))
+        {
+            dropEmptyBucket(table, slot);
+            unindexKeys(store, entry, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// ************* Family name tree (AVL) ***************
+
+static int nodeHeight(const StoreEntry *node)
+{
+    return node != NULL ? node->height : 0;
+}
+
+// Orders by family name in any case, then by card address so that every node has its own place
+static int compareEntries(const StoreEntry *first, const StoreEntry *second)
+{
+    int cmp = strcasecmp(first->family, second->family);
+    if (cmp != 0)
+    {
+        return cmp;
+    }
+    return compareCards(first->card, second->card);
+}
+
+static void updateHeight(StoreEntry *node)
+{
+    int left = nodeHeight(node->left);
+    int right = nodeHeight(node->right);
+    node->height = 1 + (left > right ? left : right);
+}
+
+static StoreEntry *rotateRight(StoreEntry *node)
+{
+    StoreEntry *top = node->left;
+    node->left = top->right;
+    top->right = node;
+    updateHeight(node);
+    updateHeight(top);
+    return top;
+}
+
+static StoreEntry *rotateLeft(StoreEntry *node)
+{
+    StoreEntry *top = node->right;
+    node->right = top->left;
+    top->left = node;
+    updateHeight(node);
+    updateHeight(top);
+    return top;
+}
+
+static StoreEntry *rebalance(StoreEntry *node)
+{
+    updateHeight(node);
+    int balance = nodeHeight(node->left) - nodeHeight(node->right);
+
+    if (balance > 1)
+    {
+        if (nodeHeight(node->left->left) < nodeHeight(node->left->right))
+        {
+            node->left = rotateLeft(node->left);
+        }
+        return rotateRight(node);
+    }
+    if (balance < -1)
+    {
+        if (nodeHeight(node->right->right) < nodeHeight(node->right->left))
+        {
+            node->right = rotateRight(node->right);
+        }
+        return rotateLeft(node);
+    }
+    return node;
+}
+
+static StoreEntry *insertNode(StoreEntry *root, StoreEntry *entry)
+{
+    if (root == NULL)
+    {
+        entry->left = NULL;
+        entry->right = NULL;
+        entry->height = 1;
+        return entry;
+    }
+
+    if (compareEntries(entry, root) < 0)
+    {
+        root->left = insertNode(root->left, entry);
+    }
+    else
+    {
+        root->right = insertNode(root->right, entry);
+    }
+    return rebalance(root);
+}
+
+static StoreEntry *removeLeftmost(StoreEntry *root)
+{
+    if (root->left == NULL)
+    {
+        return root->right;
+    }
+    root->left = removeLeftmost(root->left);
+    return rebalance(root);
+}
+
+static StoreEntry *removeNode(StoreEntry *root, const StoreEntry *entry)
+{
+    if (root == NULL)
+    {
+        return NULL;
+    }
+
+    int cmp = compareEntries(entry, root);
+    if (cmp < 0)
+    {
+        root->left = removeNode(root->left, entry);
+    }
+    else if (cmp > 0)
+    {
+        root->right = removeNode(root->right, entry);
+    }
+    else
+    {
+        if (root->left == NULL || root->right == NULL)
+        {
+            return root->left != NULL ? root->left : root->right;
+        }
+
+        // Put the next entry in its place
+        StoreEntry *next = root->right;
+        while (next->left != NULL)
+        {
+            next = next->left;
+        }
+        next->right = removeLeftmost(root->right);
+        next->left = root->left;
+        root = next;
+    }
+    return rebalance(root);
+}
+
+// Visits the nodes of a subtree in [from, to].  Returns false once visit has stopped.
+static bool visitNodes(const StoreEntry *node, const char *from, const char *to,
+                       void (*visit)(Card *card, void *context, bool *stop), void *context)
+{
+    if (node == NULL)
+    {
+        return true;
+    }
+
+    bool afterFrom = (from == NULL || strcasecmp(node->family, from) >= 0);
+    bool beforeTo = (to == NULL || strcasecmp(node->family, to) <= 0);
+
+    if (afterFrom && !visitNodes(node->left, from, to, visit, context))
+    {
+        return false;
+    }
+
+    if (afterFrom && beforeTo)
+    {
+        bool stop = false;
+        visit(node->card, context, &stop);
+        if (stop)
+        {
+            return false;
+        }
+    }
+
+    return !beforeTo || visitNodes(node->right, from, to, visit, context);
+}
+
+// ************* Store ***************
+
+static void freeEntry(StoreEntry *entry)
+{
+    freeKeys(entry->keys, entry->keyCount);
+    free(entry->family);
+    free(entry);
+}
+
+static StoreEntry *findEntry(const CardStore *store, const Card *card)
+{
+    return findSlot(&store->cards, card, hashPointer(card))->value;
+}
+
+CardStore *createCardStore(void)
+{
+    CardStore *store = calloc(1, sizeof(CardStore));
+    if (store == NULL)
+    {
+        return NULL;
+    }
+
+    bool ok = initTable(&store->cards, false);
+    for (int index = 0; index < STORE_INDEXES; index++)
+    {
+        ok = initTable(&store->byKey[index], true) && ok;
+    }
+
+    if (!ok)
+    {
+        freeCardStore(store);
+        return NULL;
+    }
+    return store;
+}
+
+void freeCardStore(CardStore *store)
+{
+    if (store == NULL)
+    {
+        return;
+    }
+
+    for (size_t i = 0; store->cards.slots != NULL && i < store->cards.slotCount; i++)
+    {
+        StoreEntry *entry = store->cards.slots[i].value;
+        if (entry != NULL)
+        {
+            deleteCard(entry->card);
+            freeEntry(entry);
+        }
+    }
+    free(store->cards.slots);
+
+    for (int index = 0; index < STORE_INDEXES; index++)
+    {
+        StoreTable *table = &store->byKey[index];
+        for (size_t i = 0; table->slots != NULL && i < table->slotCount; i++)
+        {
+            if (table->slots[i].key != NULL)
+            {
+                free((char *)table->slots[i].key);
+                freeList(table->slots[i].value);
+            }
+        }
+        free(table->slots);
+    }
+
+    free(store);
+
+    // A store usually holds most of the cards of a process, so their pool slabs are worth returning
+    poolTrim();
+}
+
+VCardErrorCode addToCardStore(CardStore *store, Card *card)
+{
+    if (card == NULL || findEntry(store, card) != NULL)
+    {
+        return INV_CARD;
+    }
+
+    StoreEntry *entry = calloc(1, sizeof(StoreEntry));
+    if (entry == NULL)
+    {
+        return OTHER_ERROR;
+    }
+    entry->card = card;
+
+    if (!collectKeys(entry, card) || !reserveSlots(&store->cards, 1) || !indexKeys(store, entry))
+    {
+        freeEntry(entry);
+        return OTHER_ERROR;
+    }
+
+    TableSlot *slot = findSlot(&store->cards, card, hashPointer(card));
+    slot->key = card;
+    slot->hash = hashPointer(card);
+    slot->value = entry;
+    store->cards.count++;
+
+    if (entry->family != NULL)
+    {
+        store->families = insertNode(store->families, entry);
+    }
+    return OK;
+}
+
+// Takes an entry out of every index and the card table, and frees it
+static void dropEntry(CardStore *store, StoreEntry *entry, bool indexed)
+{
+    if (indexed)
+    {
+        unindexKeys(store, entry, entry->keyCount);
+    }
+    if (entry->family != NULL)
+    {
+        store->families = removeNode(store->families, entry);
+    }
+
+    removeSlot(&store->cards, findSlot(&store->cards, entry->card, hashPointer(entry->card)));
+    freeEntry(entry);
+}
+
+VCardErrorCode updateInCardStore(CardStore *store, Card *card)
+{
+    StoreEntry *entry = (card != NULL) ? findEntry(store, card) : NULL;
+    if (entry == NULL)
+    {
+        return INV_CARD;
+    }
+
+    // Collect the new keys before touching the indexes, so that running out of memory here changes nothing
+    StoreEntry updated = {.card = card};
+    if (!collectKeys(&updated, card))
+    {
+        freeKeys(updated.keys, updated.keyCount);
+        free(updated.family);
+        return OTHER_ERROR;
+    }
+
+    unindexKeys(store, entry, entry->keyCount);
+    if (entry->family != NULL)
+    {
+        store->families = removeNode(store->families, entry);
+    }
+
+    freeKeys(entry->keys, entry->keyCount);
+    free(entry->family);
+    entry->keys = updated.keys;
+    entry->keyCount = updated.keyCount;
+    entry->family = updated.family;
+
+    if (entry->family != NULL)
+    {
+        store->families = insertNode(store->families, entry);
+    }
+
+    if (!indexKeys(store, entry))
+    {
+        dropEntry(store, entry, false);
+        return OTHER_ERROR;
+    }
+    return OK;
+}
+
+bool removeFromCardStore(CardStore *store, Card *card)
+{
+    StoreEntry *entry = (card != NULL) ? findEntry(store, card) : NULL;
+    if (entry == NULL)
+    {
+        return false;
+    }
+
+    dropEntry(store, entry, true);
+    return true;
+}
+
+List *findInCardStore(const CardStore *store, StoreIndex index, const char *key)
+{
+    if (index < 0 || index >= STORE_INDEXES)
+    {
+        return NULL;
+    }
+
+    char *normalized = normalizeKey(index, key);
+    if (normalized == NULL)
+    {
+        return NULL;
+    }
+
+    List *cards = NULL;
+    if (normalized[0] != '\0')
+    {
+        cards = findSlot(&store->byKey[index], normalized, hashString(normalized))->value;
+    }
+
+    free(normalized);
+    return cards;
+}
+
+void visitFamilyRange(const CardStore *store, const char *from, const char *to,
+                      void (*visit)(Card *card, void *context, bool *stop), void *context)
+{
+    visitNodes(store->families, from, to, visit, context);
+}
+
+size_t cardStoreSize(const CardStore *store)
+{
+    return store->cards.count;
+}
@@ -0,0 +1,102 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCParser.h"
+#include "VCHelpers.h"
+
+// Large stdio buffer so a whole export is read with few, big sequential reads
+#define STREAM_BUFFER_SIZE (1 << 16)
+
+struct cardStream
+{
+    FILE *file;
+    char *ioBuffer;
+    CardReader reader;
+};
+
+VCardErrorCode openCardStream(const char *fileName, CardStream **stream)
+{
+    if (fileName == NULL || stream == NULL)
+    {
+        return INV_FILE;
+    }
+
+    *stream = NULL;
+
+    if (!hasCardExtension(fileName))
+    {
+        return INV_FILE;
+    }
+
+    CardStream *newStream = malloc(sizeof(CardStream));
+    if (newStream == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    newStream->file = fopen(fileName, "r");
+    if (newStream->file == NULL)
+    {
+        free(newStream);
+        return INV_FILE;
+    }
+
+    // Falls back to the default stdio buffer if this fails
+    newStream->ioBuffer = malloc(STREAM_BUFFER_SIZE);
+    if (newStream->ioBuffer != NULL)
+    {
+        setvbuf(newStream->file, newStream->ioBuffer, _IOFBF, STREAM_BUFFER_SIZE);
+    }
+
+    initCardReader(&newStream->reader, newStream->file);
+    newStream->reader.stopAtBegin = true;
+
+    *stream = newStream;
+    return OK;
+}
+
+VCardErrorCode nextCard(CardStream *stream, Card **obj)
+{
+    if (obj == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    *obj = NULL;
+
+    if (stream == NULL)
+    {
+        return INV_FILE;
+    }
+
+    bool endConsumed = false;
+    VCardErrorCode err = readNextCard(&stream->reader, NULL, obj, true, &endConsumed);
+    if (err == OK || endConsumed)
+    {
+        return err;
+    }
+
+    // Skip the rest of the bad card, leaving the next BEGIN:VCARD for the next call.  Skipping through an END:VCARD
+    // instead could eat the next card, if the bad one had no END or was only a stray line.
+    while (readPhysicalLine(&stream->reader))
+    {
+        if (strcmp(stream->reader.line, "BEGIN:VCARD\r\n") == 0)
+        {
+            stream->reader.unread = true;
+            break;
+        }
+    }
+
+    return err;
+}
+
+void closeCardStream(CardStream *stream)
+{
+    if (stream == NULL)
+    {
+        return;
+    }
+
+    freeCardReader(&stream->reader);
+    fclose(stream->file);
+    free(stream->ioBuffer);
+    free(stream);
+}
@@ -0,0 +1,437 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCView.h"
+#include "VCHelpers.h"
+#include "VCScan.h"
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static bool viewIsLine(const char *line, size_t length, const char *str)
+{
+    return length == strlen(str) && memcmp(line, str, length) == 0;
+}
+
+static StrView makeView(const char *start, const char *end)
+{
+    StrView view = {start, (size_t)(end - start)};
+    return view;
+}
+
+// Whether a CRLF and the space/tab of a fold start at offset i of a view
+static bool isFold(StrView view, size_t i)
+{
+    return view.data[i] == '\r' && i + 2 < view.length && view.data[i + 1] == '\n' &&
+           (view.data[i + 2] == ' ' || view.data[i + 2] == '\t');
+}
+
+// Copies a folded line into buffer without its folds, as createCard unfolds it.  Returns false if out of memory.
+static bool unfoldLine(LineBuffer *buffer, StrView line)
+{
+    buffer->length = 0;
+
+    size_t start = 0;
+    for (size_t i = 0; i < line.length; i++)
+    {
+        if (isFold(line, i))
+        {
+            if (!lineBufferAppend(buffer, line.data + start, i - start))
+            {
+                return false;
+            }
+            i += 2;
+            start = i + 1;
+        }
+    }
+    return lineBufferAppend(buffer, line.data + start, line.length - start);
+}
+
+// Offset in a folded line of the byte at offset in its unfolded copy
+static size_t foldedOffset(StrView line, size_t offset)
+{
+    size_t unfolded = 0;
+    for (size_t i = 0; i < line.length; i++)
+    {
+        if (isFold(line, i))
+        {
+            i += 2;
+            continue;
+        }
+        if (unfolded++ == offset)
+        {
+            return i;
+        }
+    }
+    return line.length;
+}
+
+// Offset in prop->line of the byte at offset in the unfolded line
+static size_t startOffset(const PropertyView *prop, size_t offset)
+{
+    return prop->folded ? foldedOffset(prop->line, offset) : offset;
+}
+
+// Offset in prop->line just past the byte before offset in the unfolded line, so that no view ends in a fold
+static size_t endOffset(const PropertyView *prop, size_t offset)
+{
+    return (prop->folded && offset > 0) ? foldedOffset(prop->line, offset - 1) + 1 : offset;
+}
+
+// Fills in group/name/parameters/value from a split of the unfolded line
+static void setPropertyViews(PropertyView *prop, const PropertySplit *split, PropertyId id)
+{
+    const char *start = prop->line.data;
+    size_t colon = startOffset(prop, split->colon);
+
+    prop->id = id;
+    prop->group = split->hasGroup ? makeView(start, start + endOffset(prop, split->nameStart - 1)) : makeView(start, start);
+    prop->name = makeView(start + startOffset(prop, split->nameStart), start + endOffset(prop, split->nameEnd));
+    prop->parameters = split->hasParameters ? makeView(start + startOffset(prop, split->nameEnd + 1), start + endOffset(prop, split->colon)) : makeView(start + colon, start + colon);
+    prop->value = makeView(start + startOffset(prop, split->colon + 1), start + prop->line.length);
+}
+
+static VCardErrorCode appendPropertyView(CardView *view, const PropertyView *prop)
+{
+    if (view->count == view->capacity)
+    {
+        size_t newCapacity = view->capacity ? view->capacity * 2 : 16;
+        PropertyView *grown = realloc(view->properties, newCapacity * sizeof(PropertyView));
+        if (grown == NULL)
+        {
+            return OTHER_ERROR;
+        }
+        view->properties = grown;
+        view->capacity = newCapacity;
+    }
+
+    view->properties[view->count++] = *prop;
+    return OK;
+}
+
+/*	Classifies one complete logical line, with the same rules as createCardHelper.  A folded line is
+	classified from an unfolded copy in scratch, so that a fold inside its name or between its parameters
+	changes nothing; only the views stored in prop point into the mapping.
+*/
+static VCardErrorCode finishPropertyView(CardView *view, PropertyView *prop, StructuralIndex *index, LineBuffer *scratch, bool *fnFound)
+{
+    const char *line = prop->line.data;
+    size_t length = prop->line.length;
+    if (prop->folded)
+    {
+        if (!unfoldLine(scratch, prop->line))
+        {
+            return OTHER_ERROR;
+        }
+        line = scratch->data;
+        length = scratch->length;
+    }
+
+    if (!scanStructural(line, length, index))
+    {
+        return OTHER_ERROR;
+    }
+
+    PropertySplit split;
+    PropertyId id;
+    LineKind kind;
+
+    VCardErrorCode err = classifyPropertyLine(line, index, *fnFound, &split, &id, &kind);
+    if (err != OK || kind == LINE_IGNORED)
+    {
+        return err;
+    }
+
+    // Only checks the syntax of the parameters and dates; nothing is copied
+    if (kind == LINE_PROPERTY)
+    {
+        err = forEachParameter(line, index, &split, NULL, NULL);
+    }
+    else if (kind == LINE_DATE)
+    {
+        err = checkDateLine(line, length, &split);
+    }
+    if (err != OK)
+    {
+        return err;
+    }
+
+    setPropertyViews(prop, &split, id);
+
+    if (kind == LINE_FN)
+    {
+        *fnFound = true;
+        view->fn = *prop;
+        return OK;
+    }
+
+    return appendPropertyView(view, prop);
+}
+
+// Walks the lines of the card at the start of data
+static VCardErrorCode parseCardLines(const char *data, size_t length, CardView *view, StructuralIndex *index, LineBuffer *scratch)
+{
+    size_t pos = 0;
+    bool fnFound = false;
+    bool beginFound = false;
+    bool versionFound = false;
+    bool endFound = false;
+
+    PropertyView pending;
+    bool hasPending = false;
+
+    while (pos < length)
+    {
+        const char *line = data + pos;
+        const char *newline = memchr(line, '\n', length - pos);
+
+        if (newline == NULL || newline == line || newline[-1] != '\r')
+        {
+            return INV_CARD;
+        }
+
+        size_t lineLen = (size_t)(newline - 1 - line);
+        pos = (size_t)(newline - data) + 1;
+
+        if (!beginFound)
+        {
+            if (!viewIsLine(line, lineLen, "BEGIN:VCARD"))
+            {
+                return INV_CARD;
+            }
+            beginFound = true;
+            continue;
+        }
+
+        if (!versionFound && viewIsLine(line, lineLen, "VERSION:4.0"))
+        {
+            // As in createCard, VERSION ends the pending line, so a continuation after it starts a new one
+            if (hasPending)
+            {
+                VCardErrorCode err = finishPropertyView(view, &pending, index, scratch, &fnFound);
+                if (err != OK)
+                {
+                    return err;
+                }
+                hasPending = false;
+            }
+            versionFound = true;
+            continue;
+        }
+
+        if (viewIsLine(line, lineLen, "END:VCARD"))
+        {
+            endFound = true;
+            break;
+        }
+
+        if (lineLen > 0 && (line[0] == ' ' || line[0] == '\t'))
+        {
+            // Continuation: grow the pending line over the CRLF + whitespace so it stays one view
+            if (hasPending)
+            {
+                pending.line.length = (size_t)(line + lineLen - pending.line.data);
+                pending.folded = true;
+            }
+            else
+            {
+                memset(&pending, 0, sizeof(pending));
+                pending.line = makeView(line + 1, line + lineLen);
+                hasPending = true;
+            }
+            continue;
+        }
+
+        if (hasPending)
+        {
+            VCardErrorCode err = finishPropertyView(view, &pending, index, scratch, &fnFound);
+            if (err != OK)
+            {
+                return err;
+            }
+        }
+
+        memset(&pending, 0, sizeof(pending));
+        pending.line = makeView(line, line + lineLen);
+        hasPending = true;
+    }
+
+    if (hasPending)
+    {
+        VCardErrorCode err = finishPropertyView(view, &pending, index, scratch, &fnFound);
+        if (err != OK)
+        {
+            return err;
+        }
+    }
+
+    if (!beginFound || !versionFound || !endFound || !fnFound)
+    {
+        return INV_CARD;
+    }
+
+    return OK;
+}
+
+// Parses the card at the start of data into view, without copying any of it
+static VCardErrorCode parseCardView(const char *data, size_t length, CardView *view)
+{
+    StructuralIndex index;
+    initStructuralIndex(&index);
+    LineBuffer scratch = {NULL, 0, 0};
+
+    VCardErrorCode err = parseCardLines(data, length, view, &index, &scratch);
+    freeStructuralIndex(&index);
+    free(scratch.data);
+
+    return err;
+}
+
+VCardErrorCode openCardView(const char *fileName, CardView **obj)
+{
+    if (fileName == NULL || obj == NULL)
+    {
+        return INV_FILE;
+    }
+
+    *obj = NULL;
+
+    if (!hasCardExtension(fileName))
+    {
+        return INV_FILE;
+    }
+
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+    {
+        return INV_FILE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return INV_FILE;
+    }
+
+    // mmap cannot map an empty file, and an empty file is not a card anyway
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return INV_CARD;
+    }
+
+    void *mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return INV_FILE;
+    }
+    posix_madvise(mapping, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    CardView *view = calloc(1, sizeof(CardView));
+    if (view == NULL)
+    {
+        munmap(mapping, (size_t)st.st_size);
+        return OTHER_ERROR;
+    }
+
+    view->data = mapping;
+    view->length = (size_t)st.st_size;
+
+    VCardErrorCode err = parseCardView(view->data, view->length, view);
+    if (err != OK)
+    {
+        closeCardView(view);
+        return err;
+    }
+
+    *obj = view;
+    return OK;
+}
+
+void closeCardView(CardView *obj)
+{
+    if (obj == NULL)
+    {
+        return;
+    }
+
+    if (obj->data != NULL)
+    {
+        munmap((void *)obj->data, obj->length);
+    }
+
+    free(obj->properties);
+    free(obj);
+}
+
+char *copyView(StrView view)
+{
+    char *copy = malloc(view.length + 1);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+
+    // Drop every CRLF and the single space/tab that follows it
+    size_t out = 0;
+    for (size_t i = 0; i < view.length; i++)
+    {
+        if (isFold(view, i))
+        {
+            i += 2;
+            continue;
+        }
+        copy[out++] = view.data[i];
+    }
+    copy[out] = '\0';
+
+    return copy;
+}
+
+bool viewEqualsIgnoreCase(StrView view, const char *str)
+{
+    return view.length == strlen(str) && strncasecmp(view.data, str, view.length) == 0;
+}
+
+VCardErrorCode cardViewToCard(const CardView *obj, Card **card)
+{
+    if (obj == NULL || card == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    *card = NULL;
+
+    Card *newCard = newEmptyCard(NULL);
+    if (newCard == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    bool fnFound = false;
+    for (size_t i = 0; i <= obj->count; i++)
+    {
+        // FN first, then everything else in file order
+        const PropertyView *prop = (i == 0) ? &obj->fn : &obj->properties[i - 1];
+
+        char *line = copyView(prop->line);
+        if (line == NULL)
+        {
+            deleteCard(newCard);
+            return OTHER_ERROR;
+        }
+
+        VCardErrorCode err = createCardHelper(line, newCard, &fnFound);
+        free(line);
+        if (err != OK)
+        {
+            deleteCard(newCard);
+            return err;
+        }
+    }
+
+    *card = newCard;
+    return OK;
+}
@@ -0,0 +1,180 @@
+#define _POSIX_C_SOURCE 200809L
+#include "VCParser.h"
+#include "VCHelpers.h"
+
+// Cards are collected into chunks of this size, so a large export is written with few, big writes
+#define WRITER_CHUNK_SIZE (1 << 20)
+
+struct cardWriter
+{
+    char *fileName;
+    char *tempName;
+    int fd;
+    WriteSync sync;
+
+    // Rendered cards not written yet.  Grows past WRITER_CHUNK_SIZE only for a card that is bigger.
+    char *chunk;
+    size_t used;
+    size_t capacity;
+
+    // Set once a write has failed; the target file is then left alone
+    bool failed;
+};
+
+VCardErrorCode openCardWriter(const char *fileName, const CardWriteOptions *options, CardWriter **writer)
+{
+    if (fileName == NULL || writer == NULL)
+    {
+        return INV_FILE;
+    }
+
+    *writer = NULL;
+
+    if (!hasCardExtension(fileName))
+    {
+        return INV_FILE;
+    }
+
+    CardWriter *newWriter = calloc(1, sizeof(CardWriter));
+    if (newWriter == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    newWriter->sync = options ? options->sync : WRITE_SYNC_NONE;
+    newWriter->fileName = strdup(fileName);
+    newWriter->chunk = malloc(WRITER_CHUNK_SIZE);
+    newWriter->capacity = WRITER_CHUNK_SIZE;
+    if (newWriter->fileName == NULL || newWriter->chunk == NULL)
+    {
+        free(newWriter->fileName);
+        free(newWriter->chunk);
+        free(newWriter);
+        return OTHER_ERROR;
+    }
+
+    newWriter->fd = createTempFile(fileName, &newWriter->tempName);
+    if (newWriter->fd < 0)
+    {
+        free(newWriter->fileName);
+        free(newWriter->chunk);
+        free(newWriter);
+        return INV_FILE;
+    }
+
+    *writer = newWriter;
+    return OK;
+}
+
+// Writes out the buffered cards
+static bool flushChunk(CardWriter *writer)
+{
+    if (!writer->failed && !writeAll(writer->fd, writer->chunk, writer->used))
+    {
+        writer->failed = true;
+    }
+    writer->used = 0;
+
+    return !writer->failed;
+}
+
+VCardErrorCode appendCard(CardWriter *writer, const Card *obj)
+{
+    if (writer == NULL || obj == NULL)
+    {
+        return WRITE_ERROR;
+    }
+
+    if (obj->fn == NULL || obj->fn->values == NULL || getLength(obj->fn->values) == 0)
+    {
+        return INV_CARD;
+    }
+
+    if (writer->failed)
+    {
+        return WRITE_ERROR;
+    }
+
+    // Measure first, so the card is rendered straight into the chunk in one piece
+    size_t needed = cardToFileTextInto(obj, NULL, 0);
+    if (writer->used + needed + 1 > writer->capacity)
+    {
+        if (!flushChunk(writer))
+        {
+            return WRITE_ERROR;
+        }
+
+        if (needed + 1 > writer->capacity)
+        {
+            char *grown = realloc(writer->chunk, needed + 1);
+            if (grown == NULL)
+            {
+                return OTHER_ERROR;
+            }
+            writer->chunk = grown;
+            writer->capacity = needed + 1;
+        }
+    }
+
+    writer->used += cardToFileTextInto(obj, writer->chunk + writer->used, writer->capacity - writer->used);
+    return OK;
+}
+
+static void freeCardWriter(CardWriter *writer)
+{
+    free(writer->fileName);
+    free(writer->chunk);
+    free(writer);
+}
+
+VCardErrorCode closeCardWriter(CardWriter *writer)
+{
+    if (writer == NULL)
+    {
+        return WRITE_ERROR;
+    }
+
+    bool ok = flushChunk(writer);
+    VCardErrorCode err = finishTempFile(writer->fd, writer->tempName, writer->fileName, writer->sync, ok);
+    freeCardWriter(writer);
+
+    return err;
+}
+
+void abortCardWriter(CardWriter *writer)
+{
+    if (writer == NULL)
+    {
+        return;
+    }
+
+    finishTempFile(writer->fd, writer->tempName, writer->fileName, writer->sync, false);
+    freeCardWriter(writer);
+}
+
+VCardErrorCode writeCards(const char *fileName, Card **cards, size_t n)
+{
+    if (cards == NULL && n > 0)
+    {
+        return WRITE_ERROR;
+    }
+
+    CardWriter *writer;
+    VCardErrorCode err = openCardWriter(fileName, NULL, &writer);
+    if (err != OK)
+    {
+        return err;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        err = appendCard(writer, cards[i]);
+        if (err != OK)
+        {
+            abortCardWriter(writer);
+            return err;
+        }
+    }
+
+    return closeCardWriter(writer);
+}
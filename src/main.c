@@ -0,0 +1,1570 @@
+// Test program for the parser library, built by `make test` and run from the repository root
+// (it reads the sample cards in bin/cards).  Exits with 1 if any check fails.
+
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "VCParser.h"
+#include "VCCache.h"
+#include "VCDirectory.h"
+#include "VCIndex.h"
+#include "VCLazy.h"
+#include "VCPool.h"
+#include "VCPropertySet.h"
+#include "VCScan.h"
+#include "VCStore.h"
+#include "VCView.h"
+
+#define CARDS_DIR "bin/cards"
+#define STRESS_THREADS 8
+#define STRESS_ROUNDS 20
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                 \
+    do                                                                   \
+    {                                                                    \
+        if (!(cond))                                                     \
+        {                                                                \
+            fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__);         \
+            fprintf(stderr, __VA_ARGS__);                                \
+            fprintf(stderr, "\n");                                       \
+            failures++;                                                  \
+        }                                                                \
+    } while (0)
+
+// ************* Sample cards ***************
+
+typedef struct corpus
+{
+    char **paths;
+    size_t count;
+} Corpus;
+
+static int comparePaths(const void *first, const void *second)
+{
+    return strcmp(*(char *const *)first, *(char *const *)second);
+}
+
+// Lists the .vcf files of CARDS_DIR, sorted.  Returns false if the directory cannot be read.
+static bool loadCorpus(Corpus *corpus)
+{
+    corpus->paths = NULL;
+    corpus->count = 0;
+
+    DIR *dir = opendir(CARDS_DIR);
+    if (dir == NULL)
+    {
+        return false;
+    }
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        size_t len = strlen(ent->d_name);
+        if (len < 4 || strcmp(ent->d_name + len - 4, ".vcf") != 0)
+        {
+            continue;
+        }
+
+        char **grown = realloc(corpus->paths, (corpus->count + 1) * sizeof(char *));
+        char *path = malloc(sizeof(CARDS_DIR) + len + 1);
+        if (grown == NULL || path == NULL)
+        {
+            free(path);
+            corpus->paths = grown ? grown : corpus->paths;
+            closedir(dir);
+            return false;
+        }
+        sprintf(path, "%s/%s", CARDS_DIR, ent->d_name);
+        corpus->paths = grown;
+        corpus->paths[corpus->count++] = path;
+    }
+    closedir(dir);
+
+    qsort(corpus->paths, corpus->count, sizeof(char *), comparePaths);
+    return corpus->count > 0;
+}
+
+static void freeCorpus(Corpus *corpus)
+{
+    for (size_t i = 0; i < corpus->count; i++)
+    {
+        free(corpus->paths[i]);
+    }
+    free(corpus->paths);
+}
+
+// What one parse of a file produced: createCard's code, validateCard's code and the printed card
+typedef struct parseOutcome
+{
+    VCardErrorCode parseError;
+    VCardErrorCode validError;
+    char *text;
+} ParseOutcome;
+
+static ParseOutcome parseOutcome(const char *path)
+{
+    ParseOutcome outcome = {OK, OK, NULL};
+    Card *card = NULL;
+
+    outcome.parseError = createCard((char *)path, &card);
+    if (outcome.parseError == OK)
+    {
+        outcome.validError = validateCard(card);
+        outcome.text = cardToString(card);
+        deleteCard(card);
+    }
+    return outcome;
+}
+
+static bool sameOutcome(const ParseOutcome *first, const ParseOutcome *second)
+{
+    if (first->parseError != second->parseError || first->validError != second->validError)
+    {
+        return false;
+    }
+    if (first->text == NULL || second->text == NULL)
+    {
+        return first->text == second->text;
+    }
+    return strcmp(first->text, second->text) == 0;
+}
+
+// Writes text to a temporary .vcf file named by path (at least 64 bytes).  Returns false on error.
+static bool writeTempCard(const char *text, char *path)
+{
+    snprintf(path, 64, "/tmp/vcparser-test-%ld.vcf", (long)getpid());
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    bool ok = fputs(text, file) >= 0;
+    return fclose(file) == 0 && ok;
+}
+
+// ************* Property index ***************
+
+static Property *findPropertyNamed(Card *card, const char *name)
+{
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
+    {
+        if (strcmp(prop->name, name) == 0)
+        {
+            return prop;
+        }
+    }
+    return NULL;
+}
+
+/*	Removes the N of a parsed card and adds another property through the list API alone, which leaves the
+	number of properties unchanged.  Neither the printed card nor the index may still see the old N.
+*/
+static void testIndexAfterListEdits(void)
+{
+    Card *card = NULL;
+    Card *donor = NULL;
+    CHECK(createCard(CARDS_DIR "/testCard.vcf", &card) == OK, "testCard.vcf does not parse");
+    const char donorText[] = "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Donor\r\nNOTE:moved\r\nEND:VCARD\r\n";
+    CHECK(createCardFromBuffer(donorText, strlen(donorText), &donor) == OK, "the donor card does not parse");
+    if (card == NULL || donor == NULL)
+    {
+        deleteCard(card);
+        deleteCard(donor);
+        return;
+    }
+
+    CHECK(card->index == NULL, "createCard builds the index before any lookup");
+    CHECK(getProperties(card, "N") != NULL && card->index != NULL, "testCard.vcf has no indexed N");
+    int length = getLength(card->optionalProperties);
+
+    Property *name = findPropertyNamed(card, "N");
+    Property *extra = getFromFront(donor->optionalProperties);
+    CHECK(name != NULL && extra != NULL, "missing N or donor property");
+    if (name == NULL || extra == NULL)
+    {
+        deleteCard(card);
+        deleteCard(donor);
+        return;
+    }
+
+    deleteProperty(deleteDataFromList(card->optionalProperties, name));
+    insertBack(card->optionalProperties, deleteDataFromList(donor->optionalProperties, extra));
+    CHECK(getLength(card->optionalProperties) == length, "the edit should keep the number of properties");
+
+    char *text = cardToString(card);
+    CHECK(text != NULL && strstr(text, "\nN:") == NULL, "cardToString still prints the removed N");
+    free(text);
+
+    CHECK(getProperties(card, "N") == NULL, "getProperties still finds the removed N");
+    List *moved = getProperties(card, extra->name);
+    CHECK(moved != NULL && getFromBack(moved) == extra, "getProperties does not find the added %s", extra->name);
+
+    deleteCard(card);
+    deleteCard(donor);
+}
+
+// ************* Property lists ***************
+
+// Replaces the values of every property of a parsed card the way code written against the plain List API does
+static void testReplacePropertyLists(void)
+{
+    Card *card = NULL;
+    CHECK(createCard(CARDS_DIR "/testCard.vcf", &card) == OK, "testCard.vcf does not parse");
+    if (card == NULL)
+    {
+        return;
+    }
+
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
+    {
+        freeList(prop->values);
+        prop->values = initializeList(valueToString, deleteValue, compareValues);
+        insertBack(prop->values, strdup("replaced"));
+        markPropertyDirty(card, prop);
+    }
+
+    char *text = cardToString(card);
+    CHECK(text != NULL && strstr(text, "replaced") != NULL, "the replaced values are not printed");
+    free(text);
+    deleteCard(card);
+
+    // Compact lists must still work as before
+    CardParseOptions options = {0};
+    options.compactLists = true;
+    CHECK(createCardWithOptions(CARDS_DIR "/testCard.vcf", &options, &card) == OK, "testCard.vcf does not parse with compactLists");
+    if (card != NULL)
+    {
+        prop = getFromFront(card->optionalProperties);
+        CHECK(prop != NULL && prop->values == &prop->valueList, "compactLists does not embed the value list");
+        deleteCard(card);
+    }
+}
+
+// Walks a parsed card by its nodes, as code written before vector lists does
+static void testLinkedCardLists(void)
+{
+    Card *card = NULL;
+    CHECK(createCard(CARDS_DIR "/testCard.vcf", &card) == OK, "testCard.vcf does not parse");
+    if (card == NULL)
+    {
+        return;
+    }
+
+    CHECK(card->fn->values->head != NULL && strcmp(card->fn->values->head->data, "Simon Perreault") == 0,
+          "the FN value cannot be reached through values->head");
+
+    int count = 0;
+    for (Node *node = card->optionalProperties->head; node != NULL; node = node->next)
+    {
+        Property *prop = node->data;
+        CHECK(prop->values->head != NULL, "%s has no values->head", prop->name);
+        count++;
+    }
+    CHECK(count == getLength(card->optionalProperties), "walking the nodes finds %d of %d properties", count,
+          getLength(card->optionalProperties));
+
+    CHECK(!insertBack(card->optionalProperties, NULL), "insertBack accepts NULL data");
+    deleteCard(card);
+}
+
+// A node made with initializeNode and linked by hand is freed by freeList, with the list's own nodes
+static void testInitializeNode(void)
+{
+    List *list = initializeList(valueToString, deleteValue, compareValues);
+    Node *node = initializeNode(strdup("linked by hand"));
+    if (list == NULL || node == NULL)
+    {
+        CHECK(false, "out of memory");
+        freeList(list);
+        return;
+    }
+
+    list->head = node;
+    list->tail = node;
+    list->length = 1;
+    CHECK(insertBack(list, strdup("inserted")), "insertBack fails after a hand-linked node");
+    CHECK(getLength(list) == 2 && strcmp(getFromFront(list), "linked by hand") == 0, "the hand-linked node is lost");
+    freeList(list);
+}
+
+// ************* Streams ***************
+
+// Valid cards A, B and F around a stray line and a card E with no END:VCARD
+static const char streamText[] =
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:A\r\nEND:VCARD\r\n"
+    "stray line\r\n"
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:B\r\nEND:VCARD\r\n"
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:E\r\n"
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:F\r\nEND:VCARD\r\n";
+
+static void testCardStreamResync(void)
+{
+    static const struct
+    {
+        VCardErrorCode error;
+        const char *fn;
+    } expected[] = {{OK, "A"}, {INV_CARD, NULL}, {OK, "B"}, {INV_CARD, NULL}, {OK, "F"}};
+
+    char path[64];
+    CardStream *stream = NULL;
+    if (!writeTempCard(streamText, path) || openCardStream(path, &stream) != OK)
+    {
+        CHECK(false, "cannot open a stream on %s", path);
+        return;
+    }
+
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+    {
+        Card *card = NULL;
+        VCardErrorCode err = nextCard(stream, &card);
+        CHECK(err == expected[i].error, "stream card %zu: expected %d, got %d", i, expected[i].error, err);
+        if (expected[i].fn != NULL)
+        {
+            const char *fn = (card != NULL && card->fn != NULL && card->fn->values->length > 0) ? getFromFront(card->fn->values) : "";
+            CHECK(strcmp(fn, expected[i].fn) == 0, "stream card %zu: expected FN %s, got %s", i, expected[i].fn, fn);
+        }
+        deleteCard(card);
+    }
+
+    Card *card = NULL;
+    CHECK(nextCard(stream, &card) == OK && card == NULL, "the stream does not end after the last card");
+    deleteCard(card);
+    closeCardStream(stream);
+    unlink(path);
+}
+
+// ************* Long lines ***************
+
+#define LONG_VALUE_LENGTH 200000
+
+// A NOTE of LONG_VALUE_LENGTH bytes, either on one physical line or folded every 75 bytes
+static char *longNoteCard(bool folded)
+{
+    char *text = malloc(LONG_VALUE_LENGTH * 2 + 128);
+    if (text == NULL)
+    {
+        return NULL;
+    }
+
+    char *end = text + sprintf(text, "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nNOTE:");
+    for (size_t i = 0; i < LONG_VALUE_LENGTH; i++)
+    {
+        if (folded && i > 0 && i % 75 == 0)
+        {
+            end += sprintf(end, "\r\n ");
+        }
+        *end++ = (char)('a' + i % 26);
+    }
+    sprintf(end, "\r\nEND:VCARD\r\n");
+    return text;
+}
+
+static void testLongLines(void)
+{
+    char path[64];
+    for (int folded = 0; folded < 2; folded++)
+    {
+        char *text = longNoteCard(folded);
+        if (text == NULL || !writeTempCard(text, path))
+        {
+            CHECK(false, "cannot write the long card");
+            free(text);
+            return;
+        }
+        free(text);
+
+        Card *card = NULL;
+        CHECK(createCard(path, &card) == OK, "the %s long NOTE does not parse", folded ? "folded" : "unfolded");
+        Property *note = card ? findPropertyNamed(card, "NOTE") : NULL;
+        const char *value = note ? getFromFront(note->values) : NULL;
+        CHECK(value != NULL && strlen(value) == LONG_VALUE_LENGTH && value[LONG_VALUE_LENGTH - 1] == 'a' + (LONG_VALUE_LENGTH - 1) % 26,
+              "the %s long NOTE has %zu bytes", folded ? "folded" : "unfolded", value ? strlen(value) : 0);
+        CHECK(validateFile(path) == OK, "validateFile rejects the long NOTE");
+        deleteCard(card);
+    }
+    unlink(path);
+}
+
+// ************* Structural scanner ***************
+
+static VCardErrorCode countParameter(void *context, const char *name, size_t nameLen, const char *value, size_t valueLen)
+{
+    (void)name;
+    (void)nameLen;
+    (void)value;
+    (void)valueLen;
+    (*(int *)context)++;
+    return OK;
+}
+
+static VCardErrorCode countValue(void *context, const char *value, size_t valueLen)
+{
+    (void)value;
+    (void)valueLen;
+    (*(int *)context)++;
+    return OK;
+}
+
+// A line with more structural characters than the index keeps inline, an escaped delimiter and a group
+static void testStructuralScanner(void)
+{
+    char line[1024];
+    char *end = line + sprintf(line, "item1.CATEGORIES;TYPE=work;PREF=1:a\\,b");
+    for (int i = 0; i < 100; i++)
+    {
+        end += sprintf(end, ",v%d", i);
+    }
+
+    StructuralIndex index;
+    initStructuralIndex(&index);
+    PropertySplit split;
+    CHECK(scanStructural(line, strlen(line), &index) && index.count > STRUCTURAL_INLINE_POSITIONS, "the line is not indexed");
+    CHECK(splitPropertyLine(line, &index, &split) == OK, "the line does not split");
+    CHECK(split.hasGroup && split.nameStart == 6 && split.nameEnd == 16 && split.hasParameters &&
+              split.colon == (size_t)(strchr(line, ':') - line),
+          "the line splits at %zu, %zu and %zu", split.nameStart, split.nameEnd, split.colon);
+
+    int parameters = 0;
+    int values = 0;
+    CHECK(forEachParameter(line, &index, &split, countParameter, &parameters) == OK && parameters == 2, "%d parameters", parameters);
+    CHECK(forEachValue(line, strlen(line), &index, &split, ',', countValue, &values) == OK && values == 101, "%d values", values);
+
+    const char noColon[] = "NOTE;TYPE=work";
+    const char noName[] = ":value";
+    CHECK(scanStructural(noColon, strlen(noColon), &index) && splitPropertyLine(noColon, &index, &split) == OTHER_ERROR,
+          "a line without ':' splits");
+    CHECK(scanStructural(noName, strlen(noName), &index) && splitPropertyLine(noName, &index, &split) == INV_PROP,
+          "a line without a name splits");
+    freeStructuralIndex(&index);
+}
+
+// ************* Raw passthrough ***************
+
+// Reads a whole file into a NUL-terminated heap buffer, or returns NULL
+static char *readWholeFile(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    char *text = NULL;
+    size_t length = 0;
+    char chunk[4096];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        char *grown = realloc(text, length + got + 1);
+        if (grown == NULL)
+        {
+            break;
+        }
+        text = grown;
+        memcpy(text + length, chunk, got);
+        length += got;
+        text[length] = '\0';
+    }
+    fclose(file);
+    return text;
+}
+
+// Whether writing an unchanged card parsed with keepRaw gives back the same bytes
+static void checkRawRoundTrip(const char *path, const char *what)
+{
+    CardParseOptions options = {0};
+    options.keepRaw = true;
+    Card *card = NULL;
+    if (createCardWithOptions(path, &options, &card) != OK)
+    {
+        return;
+    }
+
+    char outPath[64];
+    snprintf(outPath, sizeof(outPath), "/tmp/vcparser-raw-%ld.vcf", (long)getpid());
+    CHECK(writeCard(outPath, card) == OK, "%s: writeCard fails", what);
+    deleteCard(card);
+
+    char *original = readWholeFile(path);
+    char *written = readWholeFile(outPath);
+    CHECK(original != NULL && written != NULL && strcmp(original, written) == 0, "%s does not round-trip:\n%s",
+          what, written ? written : "(null)");
+    free(original);
+    free(written);
+    unlink(outPath);
+}
+
+static void testRawRoundTrip(const Corpus *corpus)
+{
+    for (size_t i = 0; i < corpus->count; i++)
+    {
+        checkRawRoundTrip(corpus->paths[i], corpus->paths[i]);
+    }
+
+    // FN and the dates in the middle of the card, and two of them between the same properties
+    const char text[] = "BEGIN:VCARD\r\nVERSION:4.0\r\nN:Perreault;Simon;;;\r\nANNIVERSARY:20090808T143000\r\n"
+                        "BDAY;VALUE=text:circa 1980\r\nNOTE:between\r\nFN:Simon\r\nEND:VCARD\r\n";
+    char path[64];
+    if (writeTempCard(text, path))
+    {
+        checkRawRoundTrip(path, "a card with FN and dates in the middle");
+        unlink(path);
+    }
+}
+
+// ************* Buffers ***************
+
+// createCardFromBuffer on a copy of a file's bytes, without a terminating NUL, gives what createCard gives
+static void testCardFromBuffer(const Corpus *corpus)
+{
+    for (size_t i = 0; i < corpus->count; i++)
+    {
+        char *text = readWholeFile(corpus->paths[i]);
+        size_t length = text ? strlen(text) : 0;
+        char *data = malloc(length + 1);
+        if (data == NULL)
+        {
+            CHECK(false, "out of memory");
+            free(text);
+            return;
+        }
+        memcpy(data, text ? text : "", length);
+        free(text);
+
+        ParseOutcome expected = parseOutcome(corpus->paths[i]);
+        Card *card = NULL;
+        VCardErrorCode err = createCardFromBuffer(data, length, &card);
+        char *actual = (err == OK) ? cardToString(card) : NULL;
+        CHECK(err == expected.parseError, "%s: createCardFromBuffer returns %d, createCard %d", corpus->paths[i], err, expected.parseError);
+        CHECK((actual == NULL && expected.text == NULL) || (actual != NULL && expected.text != NULL && strcmp(actual, expected.text) == 0),
+              "%s: the card from the buffer differs", corpus->paths[i]);
+
+        free(actual);
+        free(expected.text);
+        deleteCard(card);
+        free(data);
+    }
+
+    Card *card = NULL;
+    CHECK(createCardFromBuffer(NULL, 0, &card) == INV_FILE && card == NULL, "a NULL buffer is not INV_FILE");
+}
+
+// cardToStringInto returns the full length whatever the buffer size, and stores what fits like snprintf
+static void testCardToStringInto(void)
+{
+    Card *card = NULL;
+    CHECK(createCard(CARDS_DIR "/testCard.vcf", &card) == OK, "testCard.vcf does not parse");
+    char *full = card ? cardToString(card) : NULL;
+    if (full == NULL)
+    {
+        deleteCard(card);
+        return;
+    }
+
+    size_t length = strlen(full);
+    char small[10];
+    char *exact = malloc(length + 1);
+    CHECK(cardToStringInto(card, NULL, 0) == length, "cardToStringInto(NULL, 0) is not the full length");
+    CHECK(cardToStringInto(card, small, sizeof(small)) == length && strlen(small) == sizeof(small) - 1 &&
+              strncmp(small, full, sizeof(small) - 1) == 0,
+          "a truncated cardToStringInto gives \"%s\"", small);
+    CHECK(exact != NULL && cardToStringInto(card, exact, length + 1) == length && strcmp(exact, full) == 0,
+          "cardToStringInto with room for the text differs from cardToString");
+
+    free(exact);
+    free(full);
+    deleteCard(card);
+}
+
+// ************* Projections ***************
+
+// Cards whose structure breaks after the FN and BDAY a projection stops at, or in a line it skips
+static const char *const brokenTails[] = {
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nBDAY:19850412\r\nNOTE:no end\r\n",
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nBDAY:19850412\r\nNOTE:bare newline\nEND:VCARD\r\n",
+    "BEGIN:VCARD\r\nFN:Simon\r\nBDAY:19850412\r\nEND:VCARD\r\n",
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nBDAY:19850412\r\nANNIVERSARY\r\nEND:VCARD\r\n",
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nANNIVERSARY\r\nBDAY:19850412\r\nEND:VCARD\r\n",
+};
+
+static void testProjectionKeepsStructure(void)
+{
+    CardParseOptions options = {0};
+    options.properties = PROPERTY_BIT(PROP_BDAY);
+
+    char path[64];
+    for (size_t i = 0; i < sizeof(brokenTails) / sizeof(brokenTails[0]); i++)
+    {
+        if (!writeTempCard(brokenTails[i], path))
+        {
+            CHECK(false, "cannot write %s", path);
+            return;
+        }
+
+        Card *card = NULL;
+        VCardErrorCode full = createCard(path, &card);
+        deleteCard(card);
+        card = NULL;
+        VCardErrorCode projected = createCardWithOptions(path, &options, &card);
+        deleteCard(card);
+        CHECK(full != OK && projected == full, "broken card %zu: createCard returns %d, the projection %d", i, full, projected);
+    }
+
+    Card *card = NULL;
+    CHECK(createCardWithOptions(CARDS_DIR "/testCard.vcf", &options, &card) == OK && card->birthday != NULL,
+          "the projection of testCard.vcf has no BDAY");
+    deleteCard(card);
+    unlink(path);
+}
+
+// ************* Cards built by hand ***************
+
+// Adds a property with one value to a hand-built card
+static Property *addHandProperty(Card *card, const char *name, const char *value)
+{
+    Property *prop = makeProperty("", name);
+    if (prop != NULL)
+    {
+        insertBack(prop->values, strdup(value));
+        insertBack(card->optionalProperties, prop);
+    }
+    return prop;
+}
+
+// A card from makeCard has every field that deleteCard and the index read set
+static void testMakeCard(void)
+{
+    Card *card = makeCard("Made Card");
+    CHECK(card != NULL && card->arena == NULL && card->index == NULL && card->birthday == NULL, "makeCard fails");
+    if (card == NULL)
+    {
+        return;
+    }
+
+    Property *email = addHandProperty(card, "EMAIL", "made@example.com");
+    CHECK(email != NULL, "out of memory");
+    CHECK(validateCard(card) == OK, "a card from makeCard does not validate");
+    List *found = getProperties(card, "email");
+    CHECK(found != NULL && getFromFront(found) == email, "getProperties does not find EMAIL");
+
+    char *text = cardToString(card);
+    CHECK(text != NULL && strstr(text, "FN:Made Card\n") != NULL, "makeCard's FN is not printed");
+    free(text);
+    deleteCard(card);
+}
+
+// Builds a card with the constructors
+static void testHandBuiltCard(void)
+{
+    Card *card = calloc(1, sizeof(Card));
+    CHECK(card != NULL, "out of memory");
+    if (card == NULL)
+    {
+        return;
+    }
+    card->fn = makeProperty("", "FN");
+    card->optionalProperties = initializeList(propertyToString, deleteProperty, compareProperties);
+    card->birthday = makeDate("19850412", "", false);
+    card->anniversary = makeTextDate("circa 1800");
+    CHECK(card->fn != NULL && card->optionalProperties != NULL && card->birthday != NULL && card->anniversary != NULL,
+          "out of memory");
+    if (card->fn == NULL || card->optionalProperties == NULL)
+    {
+        deleteCard(card);
+        return;
+    }
+    insertBack(card->fn->values, strdup("Hand Made"));
+
+    Property *tel = addHandProperty(card, "TEL", "tel:+1-555-0100");
+    Property *name = addHandProperty(card, "n", "Made");
+    CHECK(tel != NULL && name != NULL, "out of memory");
+    if (tel == NULL || name == NULL)
+    {
+        deleteCard(card);
+        return;
+    }
+    CHECK(name->id == PROP_N, "makeProperty gives n the id %d", name->id);
+
+    CHECK(validateCard(card) == OK, "the hand-built card does not validate: %d", validateCard(card));
+    List *tels = getPropertiesById(card, PROP_TEL);
+    CHECK(tels != NULL && getFromFront(tels) == tel, "getPropertiesById does not find TEL");
+
+    char *text = cardToString(card);
+    CHECK(text != NULL && strstr(text, "\nN:Made\n") != NULL && strstr(text, "\nn:") == NULL, "N is not printed as N:\n%s",
+          text ? text : "(null)");
+    free(text);
+
+    char path[64];
+    Card *copy = NULL;
+    if (writeTempCard("", path))
+    {
+        CHECK(writeCard(path, card) == OK, "writeCard fails on the hand-built card");
+        CHECK(createCard(path, &copy) == OK, "the written hand-built card does not parse");
+        unlink(path);
+    }
+    if (copy != NULL)
+    {
+        CHECK(compareDates(copy->birthday, card->birthday) == 0 && compareDates(copy->anniversary, card->anniversary) == 0,
+              "the written dates differ");
+        deleteCard(copy);
+    }
+
+    deleteCard(card);
+}
+
+// Allocates size bytes filled with junk, like malloc might return
+static void *junkAlloc(size_t size)
+{
+    void *memory = malloc(size);
+    if (memory != NULL)
+    {
+        memset(memory, 0xA5, size);
+    }
+    return memory;
+}
+
+// A card assembled with malloc, setting only the fields that existed before the library added its own
+static void testMallocCard(void)
+{
+    Card *card = junkAlloc(sizeof(Card));
+    Property *fn = junkAlloc(sizeof(Property));
+    Property *tel = junkAlloc(sizeof(Property));
+    DateTime *bday = junkAlloc(sizeof(DateTime));
+    if (card == NULL || fn == NULL || tel == NULL || bday == NULL)
+    {
+        CHECK(false, "out of memory");
+        free(card);
+        free(fn);
+        free(tel);
+        free(bday);
+        return;
+    }
+
+    Property *props[] = {fn, tel};
+    const char *names[] = {"FN", "TEL"};
+    const char *values[] = {"Malloc Card", "tel:+1-555-0100"};
+    for (size_t i = 0; i < 2; i++)
+    {
+        props[i]->name = strdup(names[i]);
+        props[i]->group = strdup("");
+        props[i]->parameters = initializeList(parameterToString, deleteParameter, compareParameters);
+        props[i]->values = initializeList(valueToString, deleteValue, compareValues);
+        insertBack(props[i]->values, strdup(values[i]));
+    }
+    bday->UTC = false;
+    bday->isText = false;
+    bday->date = strdup("19850412");
+    bday->time = strdup("");
+    bday->text = strdup("");
+
+    card->fn = fn;
+    card->optionalProperties = initializeList(propertyToString, deleteProperty, compareProperties);
+    insertBack(card->optionalProperties, tel);
+    card->birthday = bday;
+    card->anniversary = NULL;
+
+    CHECK(validateCard(card) == OK, "the malloc'd card does not validate");
+    char *text = cardToString(card);
+    CHECK(text != NULL && strstr(text, "TEL") != NULL, "the malloc'd card is not printed");
+    free(text);
+
+    char path[64];
+    char *written = NULL;
+    if (writeTempCard("", path))
+    {
+        CHECK(writeCard(path, card) == OK, "writeCard fails on the malloc'd card");
+        written = readWholeFile(path);
+        unlink(path);
+    }
+    CHECK(written != NULL && strstr(written, "FN:Malloc Card\r\n") != NULL && strstr(written, "BDAY:19850412\r\n") != NULL,
+          "the malloc'd card is written as:\n%s", written ? written : "(null)");
+    free(written);
+
+    CHECK(propertyIdOf(tel) == PROP_TEL, "propertyIdOf ignores the name of the malloc'd TEL");
+    List *tels = getPropertiesById(card, PROP_TEL);
+    CHECK(tels != NULL && getFromFront(tels) == tel, "getPropertiesById does not find the malloc'd TEL");
+    CHECK(tel->id == PROP_TEL, "the index does not set the id of the malloc'd TEL");
+    deleteCard(card);
+}
+
+// A hand-built property has no hash yet, and must still match the same property parsed from a file
+static void testHandBuiltHash(void)
+{
+    const char text[] = "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nTEL;TYPE=work:tel:+1-555-0100\r\nEND:VCARD\r\n";
+    Card *card = NULL;
+    CHECK(createCardFromBuffer(text, strlen(text), &card) == OK, "the TEL card does not parse");
+    Property *tel = makeProperty("", "TEL");
+    Parameter *type = makeParameter("TYPE", "work");
+    PropertySet *set = createPropertySet();
+    if (card == NULL || tel == NULL || type == NULL || set == NULL)
+    {
+        CHECK(false, "out of memory");
+        deleteCard(card);
+        deleteProperty(tel);
+        deleteParameter(type);
+        freePropertySet(set);
+        return;
+    }
+
+    insertBack(tel->parameters, type);
+    insertBack(tel->values, strdup("tel:+1-555-0100"));
+    Property *parsed = getFromFront(card->optionalProperties);
+    CHECK(tel->hash == 0 && parsed->hash != 0, "unexpected hashes %llu and %llu", (unsigned long long)tel->hash,
+          (unsigned long long)parsed->hash);
+    CHECK(propertiesEqual(tel, parsed), "a hand-built TEL differs from the parsed one");
+
+    bool added = false;
+    CHECK(addToPropertySet(set, parsed, &added) == OK && added, "the parsed TEL is not added");
+    CHECK(addToPropertySet(set, tel, &added) == OK && !added, "the hand-built TEL is added as a new property");
+
+    freePropertySet(set);
+    deleteProperty(tel);
+    deleteCard(card);
+}
+
+// Dates whose key was left 0 must sort the same as parsed ones
+static void testHandBuiltDateKeys(void)
+{
+    DateTime *early = calloc(1, sizeof(DateTime));
+    DateTime *late = makeDate("--0412", "", false);
+    if (early == NULL || late == NULL)
+    {
+        CHECK(false, "out of memory");
+        free(early);
+        deleteDate(late);
+        return;
+    }
+
+    early->date = strdup("19850101");
+    early->time = strdup("");
+    early->text = strdup("");
+    CHECK(early->key == 0 && late->key != 0, "makeDate does not set the key");
+    CHECK(compareDates(early, late) > 0 && compareDates(late, early) < 0, "--0412 does not sort before 19850101");
+
+    // By their strings alone, "1985-02" would sort before "19850101"
+    deleteDate(late);
+    late = makeDate("1985-02", "", false);
+    CHECK(late != NULL && compareDates(early, late) < 0 && compareDates(late, early) > 0,
+          "19850101 does not sort before 1985-02");
+
+    deleteDate(early);
+    deleteDate(late);
+}
+
+// ************* View mode ***************
+
+// Cards with folds in awkward places, and the property each must show up as in view mode
+static const struct
+{
+    const char *text;
+    PropertyId id;
+    const char *name;
+} foldedCards[] = {
+    {"BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nANNIV\r\n ERSARY:20090808T143000\r\nEND:VCARD\r\n", PROP_ANNIVERSARY, "ANNIVERSARY"},
+    {"BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nTEL;TYPE=work;\r\n PREF=1:tel:+1-418-656-9254\r\nEND:VCARD\r\n", PROP_TEL, "TEL"},
+    {"BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nTEL;TYPE=work\r\n ;PREF=1:tel:+1-418-656-9254\r\nEND:VCARD\r\n", PROP_TEL, "TEL"},
+    {"BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nitem1.\r\n EMAIL\r\n ;TYPE=work:simon@example.com\r\nEND:VCARD\r\n", PROP_EMAIL, "EMAIL"},
+    {"BEGIN:VCARD\r\nVERSION:4.0\r\nF\r\n N:Simon\r\nNOTE:a\r\n  b\r\nEND:VCARD\r\n", PROP_NOTE, "NOTE"},
+    {"BEGIN:VCARD\r\nFN:Simon\r\nVERSION:4.0\r\n NOTE:after version\r\nEND:VCARD\r\n", PROP_NOTE, "NOTE"},
+};
+
+// Cards whose dates createCard rejects or accepts only just
+static const char *const dateCards[] = {
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nBDAY:19851312\r\nEND:VCARD\r\n",
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nANNIVERSARY:20090808T250000\r\nEND:VCARD\r\n",
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nBDAY:\r\nEND:VCARD\r\n",
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nBDAY:1985\r\n 1312\r\nEND:VCARD\r\n",
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nBDAY;VALUE=text:circa 1800\r\nEND:VCARD\r\n",
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon\r\nBDAY:--0412\r\nANNIVERSARY:T1022Z\r\nEND:VCARD\r\n",
+};
+
+// Whether openCardView gives the same error code as createCard and, on success, the same card
+static void checkViewMatchesCreateCard(const char *path, const char *what)
+{
+    Card *card = NULL;
+    CardView *view = NULL;
+    VCardErrorCode cardError = createCard((char *)path, &card);
+    VCardErrorCode viewError = openCardView(path, &view);
+    CHECK(cardError == viewError, "%s: createCard returns %d, openCardView %d", what, cardError, viewError);
+
+    if (cardError == OK && viewError == OK)
+    {
+        Card *copy = NULL;
+        CHECK(cardViewToCard(view, &copy) == OK, "%s: cardViewToCard failed", what);
+
+        char *expected = cardToString(card);
+        char *actual = cardToString(copy);
+        CHECK(expected != NULL && actual != NULL && strcmp(expected, actual) == 0, "%s: view card differs:\n%s\nvs\n%s", what,
+              expected ? expected : "(null)", actual ? actual : "(null)");
+        free(expected);
+        free(actual);
+        deleteCard(copy);
+    }
+
+    deleteCard(card);
+    closeCardView(view);
+}
+
+static void testFoldedViews(void)
+{
+    char path[64];
+    for (size_t i = 0; i < sizeof(foldedCards) / sizeof(foldedCards[0]); i++)
+    {
+        if (!writeTempCard(foldedCards[i].text, path))
+        {
+            CHECK(false, "cannot write %s", path);
+            return;
+        }
+
+        checkViewMatchesCreateCard(path, foldedCards[i].name);
+
+        CardView *view = NULL;
+        if (openCardView(path, &view) == OK)
+        {
+            const PropertyView *prop = (view->count > 0) ? &view->properties[view->count - 1] : NULL;
+            char *name = prop ? copyView(prop->name) : NULL;
+            CHECK(prop != NULL && prop->id == foldedCards[i].id && name != NULL && strcmp(name, foldedCards[i].name) == 0,
+                  "folded %s is seen as %s (id %d)", foldedCards[i].name, name ? name : "(none)", prop ? (int)prop->id : -1);
+            free(name);
+        }
+        closeCardView(view);
+    }
+    unlink(path);
+}
+
+static void testViewDates(void)
+{
+    char path[64];
+    for (size_t i = 0; i < sizeof(dateCards) / sizeof(dateCards[0]); i++)
+    {
+        if (!writeTempCard(dateCards[i], path))
+        {
+            CHECK(false, "cannot write %s", path);
+            return;
+        }
+
+        char what[32];
+        snprintf(what, sizeof(what), "date card %zu", i);
+        checkViewMatchesCreateCard(path, what);
+    }
+    unlink(path);
+}
+
+// ************* Validation ***************
+
+// validateFile and validateBuffer return what createCard followed by validateCard returns
+static void checkValidation(const char *path)
+{
+    ParseOutcome outcome = parseOutcome(path);
+    free(outcome.text);
+    VCardErrorCode expected = outcome.parseError != OK ? outcome.parseError : outcome.validError;
+
+    char *text = readWholeFile(path);
+    VCardErrorCode fromFile = validateFile(path);
+    VCardErrorCode fromBuffer = validateBuffer(text ? text : "", text ? strlen(text) : 0);
+    free(text);
+    CHECK(fromFile == expected && fromBuffer == expected, "%s: validateFile returns %d, validateBuffer %d, createCard and validateCard %d",
+          path, fromFile, fromBuffer, expected);
+}
+
+static void testValidation(const Corpus *corpus)
+{
+    for (size_t i = 0; i < corpus->count; i++)
+    {
+        checkValidation(corpus->paths[i]);
+    }
+
+    const char *const *tables[] = {dateCards, brokenTails};
+    size_t sizes[] = {sizeof(dateCards) / sizeof(dateCards[0]), sizeof(brokenTails) / sizeof(brokenTails[0])};
+    char path[64];
+    for (size_t t = 0; t < 2; t++)
+    {
+        for (size_t i = 0; i < sizes[t]; i++)
+        {
+            if (!writeTempCard(tables[t][i], path))
+            {
+                CHECK(false, "cannot write %s", path);
+                return;
+            }
+            checkValidation(path);
+        }
+    }
+    unlink(path);
+}
+
+// ************* Card cache ***************
+
+// The FN of the card the cache holds for path, or "" if it cannot be parsed (the result is static)
+static const char *cachedName(const char *path)
+{
+    static char name[64];
+    CachedCard *entry = NULL;
+    name[0] = '\0';
+    if (getCachedCard(path, &entry) == OK)
+    {
+        snprintf(name, sizeof(name), "%s", (char *)getFromFront(cachedCardData(entry)->fn->values));
+    }
+    releaseCachedCard(entry);
+    return name;
+}
+
+// Cached cards are reused until writeCard replaces the file, or its size or modification time changes
+static void testCardCache(void)
+{
+    char path[64];
+    if (!writeTempCard("BEGIN:VCARD\r\nVERSION:4.0\r\nFN:First\r\nEND:VCARD\r\n", path))
+    {
+        CHECK(false, "cannot write %s", path);
+        return;
+    }
+
+    CachedCard *first = NULL;
+    CachedCard *second = NULL;
+    CHECK(getCachedCard(path, &first) == OK && getCachedCard(path, &second) == OK &&
+              cachedCardData(first) == cachedCardData(second),
+          "the second lookup parses the file again");
+    releaseCachedCard(first);
+    releaseCachedCard(second);
+
+    Card *card = makeCard("Written");
+    CHECK(card != NULL && writeCard(path, card) == OK, "writeCard fails");
+    deleteCard(card);
+    CHECK(strcmp(cachedName(path), "Written") == 0, "the cache misses writeCard: %s", cachedName(path));
+
+    // Rewritten behind the cache's back, first with another size, then with the same size and another time
+    writeTempCard("BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Resized\r\nEND:VCARD\r\n", path);
+    CHECK(strcmp(cachedName(path), "Resized") == 0, "the cache misses a size change: %s", cachedName(path));
+
+    writeTempCard("BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Retimed\r\nEND:VCARD\r\n", path);
+    struct timespec times[2] = {{0, UTIME_OMIT}, {time(NULL) + 100, 0}};
+    CHECK(utimensat(AT_FDCWD, path, times, 0) == 0, "cannot change the time of %s", path);
+    CHECK(strcmp(cachedName(path), "Retimed") == 0, "the cache misses a time change: %s", cachedName(path));
+
+    invalidateCachedCard(path);
+    unlink(path);
+}
+
+// ************* Writing ***************
+
+// Counts the files of /tmp whose names start with prefix, e.g. temporary files left behind by a write
+static int countTempFiles(const char *prefix)
+{
+    DIR *dir = opendir("/tmp");
+    if (dir == NULL)
+    {
+        return -1;
+    }
+
+    int count = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        count += (strncmp(ent->d_name, prefix, strlen(prefix)) == 0);
+    }
+    closedir(dir);
+    return count;
+}
+
+// A write that cannot replace its target fails without touching it or leaving its temporary file behind
+static void testAtomicWrite(void)
+{
+    char temps[64];
+    char path[80];
+    snprintf(path, sizeof(path), "/tmp/vcparser-test-%ld-dir.vcf", (long)getpid());
+    snprintf(temps, sizeof(temps), "%s.tmp", path + strlen("/tmp/"));
+
+    Card *card = makeCard("Atomic");
+    if (card == NULL || mkdir(path, 0700) != 0)
+    {
+        CHECK(false, "cannot set up %s", path);
+        deleteCard(card);
+        return;
+    }
+
+    // The target is a directory, so the rename at the end fails
+    CardWriteOptions options = {WRITE_SYNC_FILE_AND_DIRECTORY};
+    CHECK(writeCardWithOptions(path, card, &options) == WRITE_ERROR, "writing over a directory succeeds");
+    CHECK(countTempFiles(temps) == 0, "the failed write leaves a temporary file");
+    rmdir(path);
+
+    CHECK(writeCard("/tmp/vcparser-no-such-dir/card.vcf", card) == INV_FILE, "writing into a missing directory is not INV_FILE");
+
+    CHECK(writeCardWithOptions(path, card, &options) == OK, "a synced write fails");
+    char *text = readWholeFile(path);
+    CHECK(text != NULL && strstr(text, "FN:Atomic\r\n") != NULL && countTempFiles(temps) == 0, "the synced write is wrong");
+    free(text);
+
+    unlink(path);
+    deleteCard(card);
+}
+
+// The FNs of the cards of a multi-card file, joined by ',' (the result is static)
+static const char *streamNames(const char *path)
+{
+    static char names[256];
+    names[0] = '\0';
+
+    CardStream *stream = NULL;
+    if (openCardStream(path, &stream) != OK)
+    {
+        return names;
+    }
+    Card *card = NULL;
+    while (nextCard(stream, &card) == OK && card != NULL)
+    {
+        size_t used = strlen(names);
+        snprintf(names + used, sizeof(names) - used, "%s%s", used ? "," : "", (char *)getFromFront(card->fn->values));
+        deleteCard(card);
+    }
+    closeCardStream(stream);
+    return names;
+}
+
+// writeCards and CardWriter only replace the file once every card is written
+static void testBatchWriter(void)
+{
+    Card *cards[3] = {makeCard("One"), makeCard("Two"), makeCard("Three")};
+    if (cards[0] == NULL || cards[1] == NULL || cards[2] == NULL)
+    {
+        CHECK(false, "out of memory");
+        for (int i = 0; i < 3; i++)
+        {
+            deleteCard(cards[i]);
+        }
+        return;
+    }
+
+    char path[64];
+    writeTempCard("", path);
+    CHECK(writeCards(path, cards, 2) == OK && strcmp(streamNames(path), "One,Two") == 0, "writeCards writes %s", streamNames(path));
+
+    // A card without an FN value fails the whole batch
+    clearList(cards[2]->fn->values);
+    CHECK(writeCards(path, cards, 3) == INV_CARD && strcmp(streamNames(path), "One,Two") == 0,
+          "a failed writeCards changes the file to %s", streamNames(path));
+
+    CardWriter *writer = NULL;
+    CHECK(openCardWriter(path, NULL, &writer) == OK && appendCard(writer, cards[1]) == OK, "cannot start a CardWriter");
+    abortCardWriter(writer);
+    CHECK(strcmp(streamNames(path), "One,Two") == 0, "an aborted CardWriter changes the file to %s", streamNames(path));
+
+    writer = NULL;
+    CHECK(openCardWriter(path, NULL, &writer) == OK, "cannot start a CardWriter");
+    if (writer != NULL)
+    {
+        CHECK(appendCard(writer, cards[1]) == OK && appendCard(writer, cards[2]) == INV_CARD && appendCard(writer, cards[0]) == OK,
+              "appendCard fails");
+        CHECK(closeCardWriter(writer) == OK && strcmp(streamNames(path), "Two,One") == 0, "the CardWriter writes %s", streamNames(path));
+    }
+
+    unlink(path);
+    for (int i = 0; i < 3; i++)
+    {
+        deleteCard(cards[i]);
+    }
+}
+
+// ************* Card store ***************
+
+// Appends the FN of each visited card to the string context, ',' separated
+static void collectName(Card *card, void *context, bool *stop)
+{
+    (void)stop;
+    char *names = context;
+    size_t used = strlen(names);
+    snprintf(names + used, 128 - used, "%s%s", used ? "," : "", (char *)getFromFront(card->fn->values));
+}
+
+// Builds a card with an N family name, and an EMAIL and TEL unless they are NULL
+static Card *storeCard(const char *fn, const char *family, const char *email, const char *tel)
+{
+    Card *card = makeCard(fn);
+    if (card != NULL)
+    {
+        addHandProperty(card, "N", family);
+        if (email != NULL)
+        {
+            addHandProperty(card, "EMAIL", email);
+        }
+        if (tel != NULL)
+        {
+            addHandProperty(card, "TEL", tel);
+        }
+    }
+    return card;
+}
+
+static void testCardStore(void)
+{
+    CardStore *store = createCardStore();
+    Card *alice = storeCard("Alice", "Smith", "alice@example.com", "tel:+1-519-555-0100");
+    Card *bob = storeCard("Bob", "Jones", NULL, NULL);
+    Card *other = storeCard("alice", "Brown", NULL, NULL);
+    if (store == NULL || alice == NULL || bob == NULL || other == NULL)
+    {
+        CHECK(false, "out of memory");
+        freeCardStore(store);
+        deleteCard(alice);
+        deleteCard(bob);
+        deleteCard(other);
+        return;
+    }
+
+    CHECK(addToCardStore(store, alice) == OK && addToCardStore(store, bob) == OK && addToCardStore(store, other) == OK,
+          "addToCardStore fails");
+    CHECK(addToCardStore(store, alice) == INV_CARD && cardStoreSize(store) == 3, "a card is added twice");
+
+    List *found = findInCardStore(store, STORE_BY_FN, "ALICE");
+    CHECK(found != NULL && getLength(found) == 2, "FN ALICE finds %d cards", found ? getLength(found) : 0);
+    found = findInCardStore(store, STORE_BY_EMAIL, "Alice@Example.com");
+    CHECK(found != NULL && getLength(found) == 1 && getFromFront(found) == alice, "EMAIL does not find Alice");
+    found = findInCardStore(store, STORE_BY_TEL, "+1 (519) 555-0100");
+    CHECK(found != NULL && getLength(found) == 1 && getFromFront(found) == alice, "TEL does not find Alice");
+
+    char names[128] = "";
+    visitFamilyRange(store, "B", "K", collectName, names);
+    CHECK(strcmp(names, "alice,Bob") == 0, "the family names from B to K are %s", names);
+    names[0] = '\0';
+    visitFamilyRange(store, "smith", "smith", collectName, names);
+    CHECK(strcmp(names, "Alice") == 0, "the family name Smith finds %s", names);
+
+    Property *email = findPropertyNamed(alice, "EMAIL");
+    CHECK(email != NULL && setPropertyValue(alice, email, "smith@example.com") == OK && updateInCardStore(store, alice) == OK,
+          "updateInCardStore fails");
+    CHECK(findInCardStore(store, STORE_BY_EMAIL, "alice@example.com") == NULL, "the old EMAIL still finds Alice");
+    found = findInCardStore(store, STORE_BY_EMAIL, "smith@example.com");
+    CHECK(found != NULL && getFromFront(found) == alice, "the new EMAIL does not find Alice");
+
+    CHECK(removeFromCardStore(store, bob) && !removeFromCardStore(store, bob) && cardStoreSize(store) == 2, "removeFromCardStore fails");
+    CHECK(findInCardStore(store, STORE_BY_FN, "Bob") == NULL, "a removed card is still found");
+    deleteCard(bob);
+    freeCardStore(store);
+}
+
+// ************* Lazy mode ***************
+
+// Whether two printed values are both absent or equal, for CHECK messages
+static void sameText(char *expected, char *actual, const char *what, const char *field)
+{
+    bool same = (expected == NULL) == (actual == NULL) && (expected == NULL || strcmp(expected, actual) == 0);
+    CHECK(same, "%s: lazy %s is \"%s\", createCard's \"%s\"", what, field, actual ? actual : "(null)",
+          expected ? expected : "(null)");
+    free(expected);
+    free(actual);
+}
+
+// Whether openLazyCard gives the same error code as createCard and, on success, the same FN, dates and properties
+static void checkLazyMatchesCreateCard(const char *path, const char *what)
+{
+    Card *card = NULL;
+    LazyCard *lazy = NULL;
+    VCardErrorCode cardError = createCard((char *)path, &card);
+    VCardErrorCode lazyError = openLazyCard(path, &lazy);
+    CHECK(cardError == lazyError, "%s: createCard returns %d, openLazyCard %d", what, cardError, lazyError);
+
+    if (cardError == OK && lazyError == OK)
+    {
+        Property *fn = NULL;
+        CHECK(getLazyFN(lazy, &fn) == OK, "%s: getLazyFN failed", what);
+        sameText(propertyToString(card->fn), fn ? propertyToString(fn) : NULL, what, "FN");
+
+        DateTime *birthday = NULL;
+        DateTime *anniversary = NULL;
+        CHECK(getLazyDate(lazy, PROP_BDAY, &birthday) == OK, "%s: getLazyDate(BDAY) failed", what);
+        CHECK(getLazyDate(lazy, PROP_ANNIVERSARY, &anniversary) == OK, "%s: getLazyDate(ANNIVERSARY) failed", what);
+        sameText(card->birthday ? dateToString(card->birthday) : NULL, birthday ? dateToString(birthday) : NULL, what, "BDAY");
+        sameText(card->anniversary ? dateToString(card->anniversary) : NULL, anniversary ? dateToString(anniversary) : NULL, what,
+                 "ANNIVERSARY");
+
+        // Every line that is not the FN or a date is one of the card's optional properties, in file order
+        ListIterator iter = createIterator(card->optionalProperties);
+        for (size_t i = 0; i < lazy->view->count; i++)
+        {
+            Property *prop = NULL;
+            if (getLazyProperty(lazy, i, &prop) == INV_PROP)
+            {
+                continue;
+            }
+            Property *expected = nextElement(&iter);
+            sameText(expected ? propertyToString(expected) : NULL, prop ? propertyToString(prop) : NULL, what, "property");
+        }
+        CHECK(nextElement(&iter) == NULL, "%s: lazy card has fewer properties than createCard's", what);
+    }
+
+    deleteCard(card);
+    closeLazyCard(lazy);
+}
+
+static void testLazyMatchesCreateCard(const Corpus *corpus)
+{
+    for (size_t i = 0; i < corpus->count; i++)
+    {
+        checkLazyMatchesCreateCard(corpus->paths[i], corpus->paths[i]);
+    }
+
+    char path[64];
+    for (size_t i = 0; i < sizeof(foldedCards) / sizeof(foldedCards[0]); i++)
+    {
+        if (!writeTempCard(foldedCards[i].text, path))
+        {
+            CHECK(false, "cannot write %s", path);
+            return;
+        }
+        checkLazyMatchesCreateCard(path, foldedCards[i].name);
+    }
+
+    for (size_t i = 0; i < sizeof(dateCards) / sizeof(dateCards[0]); i++)
+    {
+        if (!writeTempCard(dateCards[i], path))
+        {
+            CHECK(false, "cannot write %s", path);
+            return;
+        }
+
+        char what[32];
+        snprintf(what, sizeof(what), "date card %zu", i);
+        checkLazyMatchesCreateCard(path, what);
+    }
+    unlink(path);
+}
+
+// ************* Directories ***************
+
+// parseDirectory gives every file the codes of createCard and validateCard; validateDirectory the same without cards
+static void testDirectories(void)
+{
+    ParseResult *parsed = NULL;
+    ParseResult *checked = NULL;
+    size_t parsedCount = 0;
+    size_t checkedCount = 0;
+    CHECK(parseDirectory(CARDS_DIR, 4, NULL, NULL, &parsed, &parsedCount) == OK, "parseDirectory fails");
+    CHECK(validateDirectory(CARDS_DIR, 4, &checked, &checkedCount) == OK, "validateDirectory fails");
+    CHECK(parsedCount > 0 && parsedCount == checkedCount, "the directory has %zu files for parseDirectory and %zu for validateDirectory",
+          parsedCount, checkedCount);
+
+    for (size_t i = 0; i < parsedCount && i < checkedCount; i++)
+    {
+        ParseOutcome outcome = parseOutcome(parsed[i].path);
+        VCardErrorCode expected = outcome.parseError != OK ? outcome.parseError : outcome.validError;
+        free(outcome.text);
+
+        CHECK(strcmp(parsed[i].path, checked[i].path) == 0, "results %zu are %s and %s", i, parsed[i].path, checked[i].path);
+        CHECK(parsed[i].error == expected && (parsed[i].card != NULL) == (outcome.parseError == OK),
+              "%s: parseDirectory gives %d, createCard and validateCard %d", parsed[i].path, parsed[i].error, expected);
+        CHECK(checked[i].error == expected && checked[i].card == NULL, "%s: validateDirectory gives %d, createCard and validateCard %d",
+              checked[i].path, checked[i].error, expected);
+    }
+
+    freeParseResults(parsed, parsedCount);
+    freeParseResults(checked, checkedCount);
+    CHECK(validateDirectory("/nonexistent-vcparser-dir", 0, &checked, &checkedCount) == INV_FILE, "a missing directory is not INV_FILE");
+}
+
+// ************* Pools ***************
+
+#define POOL_TEST_OBJECTS 100000
+#define POOL_TEST_SIZE 64
+
+static void *allocatePoolObjects(void *arg)
+{
+    void **objects = arg;
+    for (size_t i = 0; i < POOL_TEST_OBJECTS; i++)
+    {
+        objects[i] = poolAlloc(POOL_TEST_SIZE);
+    }
+    return NULL;
+}
+
+// Objects allocated on one thread and freed on another must not stay with the freeing thread, and poolTrim must release their slabs
+static void testPoolCrossThreadFree(void)
+{
+    void **objects = calloc(POOL_TEST_OBJECTS, sizeof(void *));
+    pthread_t producer;
+    if (objects == NULL || pthread_create(&producer, NULL, allocatePoolObjects, objects) != 0)
+    {
+        CHECK(false, "cannot start the producer thread");
+        free(objects);
+        return;
+    }
+    pthread_join(producer, NULL);
+
+    for (size_t i = 0; i < POOL_TEST_OBJECTS; i++)
+    {
+        CHECK(objects[i] != NULL, "poolAlloc failed");
+        poolFree(objects[i], POOL_TEST_SIZE);
+    }
+    free(objects);
+
+    // All but a few of the slabs that held the objects must come back
+    size_t released = poolTrim();
+#ifndef POOL_USE_MALLOC
+    size_t expected = (size_t)POOL_TEST_OBJECTS * POOL_TEST_SIZE * 9 / 10;
+    CHECK(released >= expected, "poolTrim releases %zu bytes, expected at least %zu", released, expected);
+#else
+    CHECK(released == 0, "poolTrim releases %zu bytes with POOL_USE_MALLOC", released);
+#endif
+}
+
+// ************* Multithreaded stress test ***************
+
+typedef struct stressWorker
+{
+    pthread_t thread;
+    int number;
+    const Corpus *corpus;
+    const ParseOutcome *expected;
+    int mismatches;
+} StressWorker;
+
+/*	Parses, validates, prints and writes every sample card STRESS_ROUNDS times, each thread starting at a
+	different file, and compares everything with what one thread got before the others started.  Written
+	cards are parsed again and must print the same as the original.
+*/
+static void *stressWorker(void *arg)
+{
+    StressWorker *worker = arg;
+    char outPath[64];
+    snprintf(outPath, sizeof(outPath), "/tmp/vcparser-stress-%ld-%d.vcf", (long)getpid(), worker->number);
+
+    for (int round = 0; round < STRESS_ROUNDS; round++)
+    {
+        for (size_t n = 0; n < worker->corpus->count; n++)
+        {
+            size_t i = (n + (size_t)worker->number) % worker->corpus->count;
+            ParseOutcome outcome = parseOutcome(worker->corpus->paths[i]);
+            if (!sameOutcome(&outcome, &worker->expected[i]))
+            {
+                worker->mismatches++;
+            }
+            free(outcome.text);
+
+            Card *card = NULL;
+            if (createCard(worker->corpus->paths[i], &card) != OK || validateCard(card) != OK)
+            {
+                deleteCard(card);
+                continue;
+            }
+
+            if (writeCard(outPath, card) != OK)
+            {
+                worker->mismatches++;
+            }
+            else
+            {
+                ParseOutcome written = parseOutcome(outPath);
+                if (written.parseError != OK || written.text == NULL || strcmp(written.text, worker->expected[i].text) != 0)
+                {
+                    worker->mismatches++;
+                }
+                free(written.text);
+            }
+            deleteCard(card);
+        }
+    }
+
+    unlink(outPath);
+    return NULL;
+}
+
+static void testThreadedParsing(const Corpus *corpus)
+{
+    ParseOutcome *expected = calloc(corpus->count, sizeof(ParseOutcome));
+    CHECK(expected != NULL, "out of memory");
+    if (expected == NULL)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < corpus->count; i++)
+    {
+        expected[i] = parseOutcome(corpus->paths[i]);
+    }
+
+    StressWorker workers[STRESS_THREADS];
+    int started = 0;
+    for (int t = 0; t < STRESS_THREADS; t++)
+    {
+        workers[t] = (StressWorker){.number = t, .corpus = corpus, .expected = expected, .mismatches = 0};
+        if (pthread_create(&workers[t].thread, NULL, stressWorker, &workers[t]) != 0)
+        {
+            break;
+        }
+        started++;
+    }
+    CHECK(started == STRESS_THREADS, "started %d of %d threads", started, STRESS_THREADS);
+
+    for (int t = 0; t < started; t++)
+    {
+        pthread_join(workers[t].thread, NULL);
+        CHECK(workers[t].mismatches == 0, "thread %d: %d results differ from the single-threaded parse", t, workers[t].mismatches);
+    }
+
+    for (size_t i = 0; i < corpus->count; i++)
+    {
+        free(expected[i].text);
+    }
+    free(expected);
+}
+
+int main(void)
+{
+    Corpus corpus;
+    if (!loadCorpus(&corpus))
+    {
+        fprintf(stderr, "cannot read %s; run the tests from the repository root\n", CARDS_DIR);
+        freeCorpus(&corpus);
+        return 1;
+    }
+
+    testIndexAfterListEdits();
+    testReplacePropertyLists();
+    testLinkedCardLists();
+    testInitializeNode();
+    testCardStreamResync();
+    testLongLines();
+    testStructuralScanner();
+    testRawRoundTrip(&corpus);
+    testCardFromBuffer(&corpus);
+    testCardToStringInto();
+    testProjectionKeepsStructure();
+    testMakeCard();
+    testHandBuiltCard();
+    testMallocCard();
+    testHandBuiltHash();
+    testHandBuiltDateKeys();
+    testFoldedViews();
+    testViewDates();
+    testValidation(&corpus);
+    testCardCache();
+    testAtomicWrite();
+    testBatchWriter();
+    testCardStore();
+    testLazyMatchesCreateCard(&corpus);
+    testDirectories();
+    testThreadedParsing(&corpus);
+    testPoolCrossThreadFree();
+
+    freeCorpus(&corpus);
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
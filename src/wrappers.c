@@ -5,32 +5,64 @@
 #include <stdlib.h>
 #include <string.h>
 #include "VCParser.h"
+#include "VCDirectory.h"
+#include "VCCache.h"
 
 // Wrapper function to validate a vCard
 int validate_vcard(char *filename) {
-    Card *card = NULL;
-    VCardErrorCode result = createCard(filename, &card);
-    if (result != OK) {
-        return result; // Return error code if invalid
+    // Checks the file while reading it, without building a Card
+    return validateFile(filename);
+}
+
+// Wrapper function to validate every vCard in a directory in parallel.
+// Returns the file names of the valid ones, one per line.
+char* get_valid_vcards(char *dirname) {
+    ParseResult *results = NULL;
+    size_t count = 0;
+    // Only the error codes are needed, so no card is built
+    if (validateDirectory(dirname, 0, &results, &count) != OK) {
+        return NULL;
     }
 
-    result = validateCard(card);
-    deleteCard(card); // Free memory
-    return result;
+    size_t total = 1;
+    for (size_t i = 0; i < count; i++) {
+        total += strlen(results[i].path) + 1;
+    }
+
+    char *names = malloc(total);
+    if (names == NULL) {
+        freeParseResults(results, count);
+        return NULL;
+    }
+
+    char *end = names;
+    *end = '\0';
+    for (size_t i = 0; i < count; i++) {
+        if (results[i].error == OK) {
+            const char *slash = strrchr(results[i].path, '/');
+            end += sprintf(end, "%s\n", slash ? slash + 1 : results[i].path);
+        }
+    }
+
+    freeParseResults(results, count);
+    return names;
 }
 
 // Wrapper function to get the full name (FN property) from a vCard
 char* get_vcard_name(char *filename) {
-    Card *card = NULL;
-    VCardErrorCode result = createCard(filename, &card);
-    if (result != OK || card->fn == NULL) {
+    // The UI asks for the name and details of the same file back to back, so both go through the cache
+    CachedCard *entry = NULL;
+    VCardErrorCode result = getCachedCard(filename, &entry);
+    if (result != OK) {
         return NULL; // Return NULL if file is invalid
     }
 
-    char *name = malloc(strlen(card->fn->values->head->data) + 1);
-    strcpy(name, card->fn->values->head->data);
+    const Card *card = cachedCardData(entry);
+    const char *fn = getFromFront(card->fn->values);
+    char *name = malloc(strlen(fn) + 1);
+    strcpy(name, fn);
 
-    deleteCard(card); // Free memory
+    releaseCachedCard(entry);
     return name;
 }
 
@@ -40,15 +72,21 @@ int save_vcard(const char *filename, const Card *card) {
 }
 
 int update_vcard_name(char *filename, char *new_name) {
+    // Every line but FN is written back exactly as it was read
+    CardParseOptions options = {0};
+    options.keepRaw = true;
+
     Card *card = NULL;
-    VCardErrorCode result = createCard(filename, &card);
+    VCardErrorCode result = createCardWithOptions(filename, &options, &card);
     if (result != OK || card->fn == NULL) {
         return result; 
     }
-    
-    free(card->fn->values->head->data);
-    card->fn->values->head->data = malloc(strlen(new_name) + 1);
-    strcpy(card->fn->values->head->data, new_name);
+
+    result = setPropertyValue(card, card->fn, new_name);
+    if (result != OK) {
+        deleteCard(card);
+        return result;
+    }
 
     // Validate before saving
     result = validateCard(card);
@@ -64,20 +102,26 @@ int update_vcard_name(char *filename, char *new_name) {
 }
 
 char* get_vcard_details(char *filename) {
-    Card *card = NULL;
-    VCardErrorCode result = createCard(filename, &card);
+    CachedCard *entry = NULL;
+    VCardErrorCode result = getCachedCard(filename, &entry);
     if (result != OK) {
         return NULL;
     }
 
+    const Card *card = cachedCardData(entry);
+    char *birthday = card->birthday ? dateToString(card->birthday) : NULL;
+    char *anniversary = card->anniversary ? dateToString(card->anniversary) : NULL;
+
     char *details = malloc(8192); // Adjust as needed
     snprintf(details, 8192, "File: %s\nName: %s\nBirthday: %s\nAnniversary: %s\nOther Props: %d",
              filename,
              (char *)getFromFront(card->fn->values),
-             card->birthday ? dateToString(card->birthday) : "None",
-             card->anniversary ? dateToString(card->anniversary) : "None",
+             birthday ? birthday : "None",
+             anniversary ? anniversary : "None",
              getLength(card->optionalProperties));
 
-    deleteCard(card);
+    free(birthday);
+    free(anniversary);
+    releaseCachedCard(entry);
     return details;
 }